@@ -1,5 +1,11 @@
 #include "rtklib.h"
 #include "B2bLIB.h"
+#include <sys/stat.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #define SQR(x)      ((x)*(x))
 #define MAXRNXLEN   (16*MAXOBSTYPE+4)   /* max rinex record length */
@@ -15,8 +21,26 @@
 #define COS_5  0.9961946980917456 /* cos(-5.0 deg) */
 #define RTOL_KEPLER 1E-13         /* relative tolerance for Kepler equation */
 #define MAX_ITER_KEPLER 30        /* max number of iteration of Kelpler */
+#define NTHREADNAV 4              /* number of threads to decode rinex 4 nav */
+#define RNX4NAV_TSLIDE 21600.0    /* sliding step of rinex 4 nav window (s) */
 
+#ifdef WIN32
+#define fseekB2b(fp, off) _fseeki64(fp, (__int64)(off), SEEK_SET)
+#define ftellB2b(fp)      ((long long)_ftelli64(fp))
+#else
+#define fseekB2b(fp, off) fseeko(fp, (off_t)(off), SEEK_SET)
+#define ftellB2b(fp)      ((long long)ftello(fp))
+#endif
 
+
+static const unsigned char dcbcode_CMP[][2] = { /* obs code and Type3 signal mode of BDS */
+    {CODE_L2I, 0}, {CODE_L1D, 1}, {CODE_L1P, 2}, {CODE_L5D, 4}, {CODE_L5P, 5},
+    {CODE_L7I, 7}, {CODE_L7Q, 8}, {CODE_L6I, 12}
+};
+static const unsigned char dcbcode_GPS[][2] = { /* obs code and Type3 signal mode of GPS */
+    {CODE_L1C, 0}, {CODE_L1P, 1}, {CODE_L1L, 4}, {CODE_L1X, 5}, {CODE_L2L, 7},
+    {CODE_L2X, 8}, {CODE_L5I, 11}, {CODE_L5Q, 12}, {CODE_L5X, 12}
+};
 static const double ura_eph[] = {         /* ura values (ref [3] 20.3.3.3.1.1) */
 	2.4,3.4,4.85,6.85,9.65,13.65,24.0,48.0,96.0,192.0,384.0,768.0,1536.0,
 	3072.0,6144.0,0.0
@@ -147,7 +171,6 @@ static int decode_LDeph(int sat, gtime_t toc, const double* data, eph_t* eph)
     }
     return 1;
 }
-int BDTWeek;    //Storing Compass Week in RINEX 4.0 D1D2
 /* decode ephemeris GPS CNAV CNV2 AND BeiDou CNV123---*/
 static int decode_CNVeph(int sat, gtime_t toc, const double* data, eph_t* eph)
 {
@@ -180,7 +203,7 @@ static int decode_CNVeph(int sat, gtime_t toc, const double* data, eph_t* eph)
     eph->iode = (int)data[38];      /* AODE */
     eph->iodc = (int)data[34];      /* AODC */
 
-    eph->week = BDTWeek;      /* bdt week */
+    time2bdt(toc, &eph->week); /* bdt week of toc */
     eph->toe = bdt2gpst(bdt2time(eph->week, data[11])); /* bdt -> gpst */
     eph->ttr = bdt2gpst(bdt2time(eph->week, data[35])); /* bdt -> gpst */
     eph->toe = adjweek(eph->toe, toc);
@@ -197,704 +220,2249 @@ static int decode_CNVeph(int sat, gtime_t toc, const double* data, eph_t* eph)
     return 1;
 }
 
+/* map file to memory -----------------------------------------------------------
+   INPUT:
+   file: file path
+
+   OUTPUT:
+   size: size of file (bytes)
+   return: read-only mapping of file (NULL: error)
+-----------------------------------------------------------------------------*/
+static void* mapB2bfile(const char* file, size_t* size)
+{
+    void* map;
+#ifdef WIN32
+    HANDLE hfile, hmap;
+
+    if ((hfile = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    *size = GetFileSize(hfile, NULL);
+
+    // The view keeps the mapping and the file open after the handles are closed
+    hmap = CreateFileMapping(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hfile);
+    if (!hmap) return NULL;
+
+    map = MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hmap);
+    if (!map) return NULL;
+#else
+    struct stat st;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0) return NULL;
+
+    if (fstat(fd, &st) < 0 || st.st_size <= 0 ||
+        (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    *size = st.st_size;
+    close(fd);
+#endif
+    return map;
+}
+
+// Unmap file from memory
+static void unmapB2bfile(void* map, size_t size)
+{
+#ifdef WIN32
+    UnmapViewOfFile(map);
+#else
+    munmap(map, size);
+#endif
+}
+
+// Maximum allowed time gap to toe of B2b ephemeris depending on satellite system
+static double maxdtoeB2b(int sat)
+{
+    switch (satsys(sat, NULL)) {
+    case SYS_QZS: return MAXDTOE_QZS + 1.0;
+    case SYS_GAL: return MAXDTOE_GAL + 1.0;
+    case SYS_CMP: return MAXDTOE_CMP + 1.0;
+    default:      return MAXDTOE + 1.0;
+    }
+}
+
+typedef struct {        /* rinex 4.0 navigation body chunk type */
+    const char* p;      /* start of chunk (at a record) */
+    const char* pe;     /* end of chunk */
+    int n, nmax;        /* number of ephemerides / max allocated */
+    int stat;           /* status (1:ok,0:toc error,-1:memory allocation error) */
+    gtime_t ts, te;     /* toe window (ts/te.time==0: no limit) */
+    gtime_t tmin, tmax; /* toe range of decoded ephemerides */
+    eph_t* eph;         /* decoded ephemerides */
+} navchunk_t;
+
+// Get next line of mapped file as a string (0: end of chunk)
+static int getRinex4line(const char** p, const char* pe, char* buff)
+{
+    const char* q;
+    int n;
+
+    if (*p >= pe) return 0;
+
+    if (!(q = (const char*)memchr(*p, '\n', pe - *p))) q = pe;
+    n = q - *p < MAXRNXLEN - 2 ? (int)(q - *p) : MAXRNXLEN - 2;
+    memcpy(buff, *p, n);
+    buff[n++] = '\n';
+    buff[n] = '\0';
+    *p = q < pe ? q + 1 : pe;
+    return 1;
+}
+
+/* decode rinex 4.0 navigation body chunk ---------------------------------------
+   Only the GPS LNAV and BeiDou CNV1 ephemerides are decoded, the other records
+   (STO, EOP, ION and ephemerides of other navigation messages) are skipped.
+   Ephemerides with toe out of the window extended by the max age of ephemeris
+   are decoded to update the toe range but not stored.
+-----------------------------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI decodeRinex4chunk(void* arg)
+#else
+static void* decodeRinex4chunk(void* arg)
+#endif
+{
+    navchunk_t* chunk = (navchunk_t*)arg;
+    const char* p = chunk->p, * r;
+    eph_t eph, * nav_eph;
+    gtime_t toc;
+    double data[64];
+    char buff[MAXRNXLEN], id[8] = "", * q;
+    int i, j, sat, sys, nd, stat;
+
+    while (chunk->stat > 0 && getRinex4line(&p, chunk->pe, buff)) {
+        if (strncmp(buff, "> EPH", 5)) continue;
+
+        memcpy(id, buff + 6, 3); id[3] = '\0';
+        // Calculate the corresponding satellite number in the navigation message for RTKLIB
+        sat = satid2no(id);
+        sys = satsys(sat, NULL);
+        if (sys != SYS_GPS && sys != SYS_CMP) continue;
+
+        // LNAV contains 31 data points, CNV1 and CNV2 together contain 39
+        if (!strncmp(buff + 10, "LNAV", 4)) nd = 29;
+        else if (!strncmp(buff + 10, "CNV1", 4)) nd = 39;
+        else continue;
+
+        memset(data, 0, sizeof(data));
+        for (i = 0, r = p; i < nd && getRinex4line(&p, chunk->pe, buff); r = p) { // Read ephemeris parameters
+            if (buff[0] == '\n') continue;
+            if (buff[0] == '>') { // Truncated record
+                p = r;
+                break;
+            }
+            if (i == 0) {
+                if (str2time(buff + 4, 0, 19, &toc)) {          /* Decode time field */
+                    printf("rinex nav toc error: %23.23s\n", buff);
+                    chunk->stat = 0;
+                    break;
+                }
+                for (j = 0, q = buff + 4 + 19; j < 3; j++, q += 19) { /* Decode data fields */
+                    data[i++] = str2num(q, 0, 19);
+                }
+            }
+            else {
+                for (j = 0, q = buff + 4; j < 4; j++, q += 19) {     /* Decode subsequent data fields */
+                    data[i++] = str2num(q, 0, 19);
+                }
+            }
+        }
+        if (i < nd) continue;
+
+        stat = nd == 29 ? decode_LDeph(sat, toc, data, &eph) : decode_CNVeph(sat, toc, data, &eph);
+        if (!stat) continue;
+        eph.rnx4 = 1; // Evicted by the sliding window
+
+        if (!chunk->tmin.time || timediff(eph.toe, chunk->tmin) < 0.0) chunk->tmin = eph.toe;
+        if (!chunk->tmax.time || timediff(eph.toe, chunk->tmax) > 0.0) chunk->tmax = eph.toe;
+
+        if (chunk->ts.time && timediff(eph.toe, chunk->ts) < -maxdtoeB2b(sat)) continue;
+        if (chunk->te.time && timediff(eph.toe, chunk->te) > maxdtoeB2b(sat)) continue;
+
+        if (chunk->nmax <= chunk->n) {
+            chunk->nmax += 1024;
+            if (!(nav_eph = (eph_t*)realloc(chunk->eph, sizeof(eph_t) * chunk->nmax))) {
+                chunk->stat = -1;
+                break;
+            }
+            chunk->eph = nav_eph;
+        }
+        chunk->eph[chunk->n++] = eph;
+    }
+    return 0;
+}
+
+// Read rinex 4.0 navigation file within toe window and get toe range of file
+static int readRinex4file(const char* file, gtime_t ts, gtime_t te, nav_t* nav,
+    gtime_t* trange)
+{
+    navchunk_t chunk[NTHREADNAV] = { { 0 } };
+    thread_t thread[NTHREADNAV];
+    const char* map, * p, * pe;
+    eph_t* nav_eph;
+    size_t size;
+    double ver = 0.0;
+    char buff[MAXRNXLEN], * label = buff + 60;
+    int i, n = 0, stat = 1, run[NTHREADNAV] = { 0 };
+
+    if (!(map = (const char*)mapB2bfile(file, &size))) {
+        printf("*** ERROR: open Rinex4.0 nav file failed, please check it!\n");
+        return 0;
+    }
+    p = map; pe = map + size;
+
+    // Header section, only store leap seconds
+    while (getRinex4line(&p, pe, buff)) {
+        if (strstr(label, "RINEX VERSION / TYPE")) {
+            ver = str2num(buff, 0, 9);
+        }
+        else if (strstr(label, "LEAP SECONDS")) {
+            nav->leaps = (int)str2num(buff, 0, 6);
+        }
+        else if (strstr(label, "END OF HEADER")) break;
+    }
+    if (ver < 4.0) {
+        unmapB2bfile((void*)map, size);
+        return 0;
+    }
+    // Split the body into chunks at record boundaries
+    for (i = 0; i < NTHREADNAV; i++) {
+        chunk[i].p = i == 0 ? p : chunk[i - 1].pe;
+        chunk[i].pe = pe;
+        chunk[i].stat = 1;
+        chunk[i].ts = ts;
+        chunk[i].te = te;
+        if (i == NTHREADNAV - 1) break;
+
+        for (p = chunk[i].p + (pe - chunk[i].p) / (NTHREADNAV - i); p < pe; p++) {
+            if (p[-1] == '\n' && p + 1 < pe && p[0] == '>' && p[1] == ' ') break;
+        }
+        chunk[i].pe = p;
+    }
+    // Decode chunks in parallel threads
+    for (i = 0; i < NTHREADNAV; i++) {
+#ifdef WIN32
+        run[i] = (thread[i] = CreateThread(NULL, 0, decodeRinex4chunk, chunk + i, 0, NULL)) != NULL;
+#else
+        run[i] = !pthread_create(thread + i, NULL, decodeRinex4chunk, chunk + i);
+#endif
+        if (!run[i]) decodeRinex4chunk(chunk + i);
+    }
+    for (i = 0; i < NTHREADNAV; i++) {
+        if (!run[i]) continue;
+#ifdef WIN32
+        WaitForSingleObject(thread[i], INFINITE);
+        CloseHandle(thread[i]);
+#else
+        pthread_join(thread[i], NULL);
+#endif
+    }
+    unmapB2bfile((void*)map, size);
+
+    // Merge the ephemerides of the chunks in the file order
+    for (i = 0; i < NTHREADNAV; i++) {
+        if (chunk[i].stat <= 0) stat = 0;
+        n += chunk[i].n;
+        if (!trange || !chunk[i].tmin.time) continue;
+        if (!trange[0].time || timediff(chunk[i].tmin, trange[0]) < 0.0) trange[0] = chunk[i].tmin;
+        if (!trange[1].time || timediff(chunk[i].tmax, trange[1]) > 0.0) trange[1] = chunk[i].tmax;
+    }
+    if (stat && n > 0) {
+        if (nav->nmax < nav->n + n) {
+            if (!(nav_eph = (eph_t*)realloc(nav->eph, sizeof(eph_t) * (nav->n + n)))) {
+                trace(1, "readRinex4Nav malloc error: n=%d\n", nav->n + n);
+                stat = 0;
+            }
+            else {
+                nav->eph = nav_eph;
+                nav->nmax = nav->n + n;
+            }
+        }
+        for (i = 0; stat && i < NTHREADNAV; i++) {
+            memcpy(nav->eph + nav->n, chunk[i].eph, sizeof(eph_t) * chunk[i].n);
+            nav->n += chunk[i].n;
+        }
+    }
+    for (i = 0; i < NTHREADNAV; i++) free(chunk[i].eph);
+
+    return stat;
+}
+
 /* read rinex 4.0 navigation data, store information consistent with message 71 and 72 --
    Information like STO, EOP, ION are not used at the moment. Positioning has been reserved
    for future storage in respective structures, you can add the necessary structures here later.
    
    INPUT: 
    file: rinex 4.0 navigation file
+   ts, te: processing time span (ts/te.time==0: no limit)
 
    OUTPUT:
    struct: nav_t* nav (a pointer to a structure nav_t that stores navigation information extracted from the RINEX 4.0 navigation file))
 
+   NOTE:
+   The file is mapped and read in a single pass. The body is split into
+   NTHREADNAV chunks at "> " record boundaries, which are decoded in parallel
+   threads. The ephemerides of the chunks are merged in the file order.
+   Only the ephemerides with toe within the time span extended by the max age
+   of ephemeris (MAXDTOE_*) are appended to nav->eph, so several files (e.g.
+   daily files) can be read in sequence.
+
    Copyright (C) GCC Group
 
 */
+extern int readRinex4Navt(const char* file, gtime_t ts, gtime_t te, nav_t* nav)
+{
+    if (!nav)
+        return 0;
+    return readRinex4file(file, ts, te, nav, NULL);
+}
+
 extern int readRinex4Nav(const char* file, nav_t* nav)
 {
-    nav->eph = NULL; nav->n = nav->nmax = 0;
-    eph_t ephg = { 0 }; eph_t ephb = { 0 };    gtime_t toc;
-    FILE* fp;
-    double ver = 2.10, data[64] = { 0 }; char type1 = ' ';
-    int  i, j, sat = 0, mask, stat = 0, sys, LD, CNV;
-    char buff[MAXRNXLEN], id[8] = "", * p, * label = buff + 60;
+    gtime_t t0 = { 0 };
 
-    if (!nav)
+    return readRinex4Navt(file, t0, t0, nav);
+}
+
+// Delete ephemerides of the RINEX 4 loader no longer selectable at or after
+// the time (ephemerides of other sources are kept)
+static void evictRinex4eph(nav_t* nav, gtime_t time)
+{
+    int i, j;
+
+    for (i = j = 0; i < nav->n; i++) {
+        // 60 s margin for the signal transmission time before the time
+        if (nav->eph[i].rnx4 &&
+            timediff(nav->eph[i].toe, time) < -maxdtoeB2b(nav->eph[i].sat) - 60.0) continue;
+        nav->eph[j++] = nav->eph[i];
+    }
+    trace(3, "evictRinex4eph: time=%s n=%d->%d\n", time_str(time, 0), nav->n, j);
+    nav->n = j;
+}
+
+// Read files of the set overlapping the toe window
+static int loadRinex4Nav(rnx4nav_t* rnav, nav_t* nav, gtime_t ts, gtime_t te)
+{
+    const double tmax = MAXDTOE_CMP + 1.0; // largest max age of ephemeris
+    int i, stat = 0;
+
+    for (i = 0; i < rnav->n; i++) {
+        if (timediff(rnav->file[i].te, ts) < -tmax || timediff(rnav->file[i].ts, te) > tmax) {
+            continue;
+        }
+        stat |= readRinex4file(rnav->file[i].path, ts, te, nav, NULL);
+    }
+    return stat;
+}
+
+/* open rinex 4.0 navigation files for sliding window ---------------------------
+   All the files are scanned once to get the toe range of each file. Only the
+   ephemerides of the first window [ts, ts+RNX4NAV_TSLIDE] are kept in nav->eph,
+   slideRinex4Nav() advances the window as the processing time advances.
+   Files without valid ephemerides are excluded from the set.
+
+   INPUT:
+   files, n: rinex 4.0 navigation files (e.g. daily files)
+   ts: processing start time
+
+   OUTPUT:
+   rnav: sliding window of navigation files
+   nav: navigation data
+
+   RETURN: number of files in the set
+-----------------------------------------------------------------------------*/
+extern int openRinex4Nav(rnx4nav_t* rnav, char** files, int n, gtime_t ts, nav_t* nav)
+{
+    gtime_t trange[2];
+    int i;
+
+    closeRinex4Nav(rnav);
+
+    if (n <= 0 || !(rnav->file = (rnx4navf_t*)calloc(n, sizeof(rnx4navf_t)))) return 0;
+
+    rnav->tw = timeadd(ts, RNX4NAV_TSLIDE);
+
+    for (i = 0; i < n; i++) {
+        trange[0].time = trange[1].time = 0;
+        if (!readRinex4file(files[i], ts, rnav->tw, nav, trange) || !trange[0].time) {
+            trace(2, "rinex 4 nav file invalid: %s\n", files[i]);
+            continue;
+        }
+        strncpy(rnav->file[rnav->n].path, files[i], MAXSTRPATH - 1);
+        rnav->file[rnav->n].ts = trange[0];
+        rnav->file[rnav->n++].te = trange[1];
+    }
+    trace(3, "openRinex4Nav: nfile=%d neph=%d\n", rnav->n, nav->n);
+
+    if (rnav->n <= 0) closeRinex4Nav(rnav);
+    return rnav->n;
+}
+
+/* slide rinex 4.0 navigation window -------------------------------------------
+   When the time passes the end of the loaded window, the ephemerides which can
+   no longer be selected at or after the time are deleted and the ephemerides of
+   the next window [time, time+RNX4NAV_TSLIDE] are read. The time must not go
+   backward (forward processing only).
+
+   RETURN: status (1:window updated,0:no update)
+-----------------------------------------------------------------------------*/
+extern int slideRinex4Nav(rnx4nav_t* rnav, nav_t* nav, gtime_t time)
+{
+    gtime_t ts = rnav->tw;
+
+    if (rnav->n <= 0 || timediff(time, rnav->tw) <= 0.0) return 0;
+
+    rnav->tw = timeadd(time, RNX4NAV_TSLIDE);
+
+    evictRinex4eph(nav, time);
+
+    // Ephemerides in the overlap of the windows are deleted by uniqnav()
+    loadRinex4Nav(rnav, nav, ts, rnav->tw);
+    uniqnav(nav);
+
+    trace(3, "slideRinex4Nav: time=%s neph=%d\n", time_str(time, 0), nav->n);
+    return 1;
+}
+
+// Close rinex 4.0 navigation files of sliding window
+extern void closeRinex4Nav(rnx4nav_t* rnav)
+{
+    free(rnav->file);
+    rnav->file = NULL;
+    rnav->n = 0;
+    rnav->tw.time = 0; rnav->tw.sec = 0.0;
+}
+
+// Initialize B2b correction of a satellite
+static void initB2bsatp(b2bsatp_t* b2bsatp)
+{
+    gtime_t time0 = { 0 };
+    int j;
+
+    b2bsatp->gen = b2bsatp->iodp = b2bsatp->iodssr = -1;
+
+    // Initialize Type2 data
+    b2bsatp->b2btype2.IodSsr = -1;
+    b2bsatp->b2btype2.IODN = -1;
+    b2bsatp->b2btype2.iB2b = -1;
+    b2bsatp->b2btype2.UraClass = -1;
+    b2bsatp->b2btype2.UraValue = -1;
+    b2bsatp->b2btype2.IodCorr = -1;
+    b2bsatp->b2btype2.t0 = time0;
+    b2bsatp->b2btype2.TodBDT = 0.0;
+    for (j = 0; j < 3; j++) {
+        b2bsatp->b2btype2.OrbCorr[j] = 0.0;
+    }
+    // Initialize Type3 data
+    b2bsatp->b2btype3.TodBDT = 0.0;
+    b2bsatp->b2btype3.IodSsr = -1;
+    b2bsatp->b2btype3.iB2b = -1;
+    b2bsatp->b2btype3.t0 = time0;
+    for (j = 0; j < NMODESINGAL; j++) {
+        b2bsatp->b2btype3.SatDCB[j] = 0.0;
+    }
+    // Initialize Type4 data
+    b2bsatp->b2btype4.C0 = 0.0;
+    b2bsatp->b2btype4.IodSsr = -1;
+    b2bsatp->b2btype4.Iodp = -1;
+    b2bsatp->b2btype4.IodCorr = -1;
+    b2bsatp->b2btype4.TodBDT = 0.0;
+    b2bsatp->b2btype4.t0 = time0;
+    b2bsatp->b2btype4.iB2b = -1;
+}
+
+// Initialize B2b satellite data structure
+// Initialize B2b Type1 data
+static void initB2btype1(B2bType1_t* type1)
+{
+    gtime_t time0 = { 0 };
+
+    type1->Iodp = -1;
+    type1->iB2b = -1;
+    type1->IodSsr = -1;
+    type1->t0 = time0;
+    type1->TodBDT = 0.0;
+}
+
+// Initialize B2b corrections of satellites
+extern void initB2bsat(b2bsat_t* b2bsat)
+{
+    int i;
+
+    b2bsat->nsat = b2bsat->gen = 0;
+    for (i = 0; i < MaskNSAT; i++) {
+        b2bsat->SatSlot[i] = b2bsat->sats[i] = 0;
+    }
+    // Initialize Type1 data of current and previous generation
+    initB2btype1(b2bsat->b2btype1);
+    initB2btype1(b2bsat->b2btype1 + 1);
+
+    for (i = 0; i < MAXSAT; i++) {
+        initB2bsatp(b2bsat->b2bsats + i);
+        initB2bsatp(b2bsat->b2bpres + i);
+        b2bsat->b2bsats[i].sat = b2bsat->b2bpres[i].sat = i + 1;
+        b2bsat->index[i] = -1;
+    }
+    // Type3 signal modes by obs code
+    memset(b2bsat->dcbmode, -1, sizeof(b2bsat->dcbmode));
+    for (i = 0; i < (int)(sizeof(dcbcode_CMP) / sizeof(dcbcode_CMP[0])); i++) {
+        b2bsat->dcbmode[0][dcbcode_CMP[i][0]] = (signed char)dcbcode_CMP[i][1];
+    }
+    for (i = 0; i < (int)(sizeof(dcbcode_GPS) / sizeof(dcbcode_GPS[0])); i++) {
+        b2bsat->dcbmode[1][dcbcode_GPS[i][0]] = (signed char)dcbcode_GPS[i][1];
+    }
+}
+
+// Initialize B2b satellite data structure
+extern int initB2b(nav_t* navs)
+{
+    initB2bsat(&navs->b2bsat);
+    return 1;
+}
+
+// Get satellite number from subtype index (the order of the satellite in the mask)
+extern int B2bSubtype2Sat(const int ind, b2bsat_t* b2bsat)
+{
+    if (ind < 0 || ind >= b2bsat->nsat) return -1; // Not found
+    return b2bsat->sats[ind];
+}
+
+// Find the order of a satellite in the mask of the B2b correction set
+static int B2bSatIndex(int sat, const b2bsat_t* b2bsat)
+{
+    if (sat <= 0 || sat > MAXSAT) return -1;
+    return b2bsat->index[sat - 1];
+}
+
+// Get the B2b corrections of a satellite for update in the current generation
+// The corrections of the older generation are saved on the first update
+static b2bsatp_t* B2bSatUpdate(int sat, b2bsat_t* b2bsat)
+{
+    b2bsatp_t* b2bsatp = b2bsat->b2bsats + sat - 1;
+
+    if (b2bsatp->gen != b2bsat->gen) {
+        b2bsat->b2bpres[sat - 1] = *b2bsatp;
+        b2bsatp->gen = b2bsat->gen;
+        b2bsatp->iodp = b2bsat->b2btype1->Iodp;
+        b2bsatp->iodssr = b2bsat->b2btype1->IodSsr;
+    }
+    return b2bsatp;
+}
+
+// Get the B2b corrections of a satellite of the last older generation (NULL: none)
+// A satellite missing from the masks of some generations keeps the corrections of
+// the last generation it was updated in, they are still limited by the age checks
+static const b2bsatp_t* B2bSatPrevious(int sat, const b2bsat_t* b2bsat)
+{
+    const b2bsatp_t* b2bsatp = b2bsat->b2bsats + sat - 1;
+
+    // Not updated in the current generation: the entry itself is of an older one
+    if (b2bsatp->gen >= 0 && b2bsatp->gen < b2bsat->gen) return b2bsatp;
+    b2bsatp = b2bsat->b2bpres + sat - 1;
+    return b2bsatp->gen >= 0 ? b2bsatp : NULL;
+}
+
+/* B2b text record tokenizer ---------------------------------------------------
+   The fields of a record are whitespace-separated decimal integers, floating
+   point numbers (fixed or scientific notation) and mask strings. Each field is
+   converted in place and the pointer returned is just after the field (NULL:
+   no field), so a record is decoded in a single pass without locale lookups.
+   A float of more than 19 significant digits or out of the exact power-of-ten
+   range is converted by strtod().
+-----------------------------------------------------------------------------*/
+static const double pow10B2b[] = {
+    1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7, 1E8, 1E9, 1E10, 1E11,
+    1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22
+};
+
+// Skip blanks before a B2b record field
+static const char* skipB2bfld(const char* p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    return p;
+}
+
+// Read integer field of B2b record
+static const char* B2bint(const char* p, int* val)
+{
+    int neg = 0, v = 0;
+
+    p = skipB2bfld(p);
+    if (*p == '-' || *p == '+') neg = *p++ == '-';
+    if (*p < '0' || *p > '9') return NULL;
+
+    while (*p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+    *val = neg ? -v : v;
+    return p;
+}
+
+// Read floating point field of B2b record
+static const char* B2bflt(const char* p, double* val)
+{
+    const char* q;
+    char* e;
+    unsigned long long m = 0;
+    int neg = 0, nd = 0, ne = 0, ep = 0, eneg = 0, digit = 0;
+
+    q = p = skipB2bfld(p);
+    if (*p == '-' || *p == '+') neg = *p++ == '-';
+
+    // Mantissa digits and the decimal exponent of the last digit
+    for (; *p >= '0' && *p <= '9'; p++, digit = 1) {
+        if (m || *p != '0') nd++;
+        m = m * 10 + (*p - '0');
+    }
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++, digit = 1) {
+            if (m || *p != '0') nd++;
+            m = m * 10 + (*p - '0');
+            ne--;
+        }
+    }
+    if (!digit) return NULL;
+
+    if (*p == 'e' || *p == 'E') {
+        e = (char*)p + 1;
+        if (*e == '-' || *e == '+') eneg = *e++ == '-';
+        if (*e >= '0' && *e <= '9') {
+            for (; *e >= '0' && *e <= '9' && ep < 10000; e++) ep = ep * 10 + (*e - '0');
+            p = e;
+            ne += eneg ? -ep : ep;
+        }
+    }
+    // Exact conversion if the mantissa is less than 2^53 and the power is exact
+    if (nd > 19 || m >= (1ULL << 53) || ne < -22 || ne > 22) {
+        *val = strtod(q, &e);
+        return e == q ? NULL : e;
+    }
+    *val = ne < 0 ? (double)m / pow10B2b[-ne] : (double)m * pow10B2b[ne];
+    if (neg) *val = -*val;
+    return p;
+}
+
+// Read string field of B2b record
+static const char* B2bstr(const char* p, const char** str, int* len)
+{
+    p = skipB2bfld(p);
+    for (*str = p; *p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'; p++);
+    *len = (int)(p - *str);
+    return *len > 0 ? p : NULL;
+}
+
+/* decode B2b text records -----------------------------------------------------
+   Each correction file holds one record per line, columns as written by the
+   B2b message logger:
+
+   Type1: Week Sow Tod SSRGap IODSSR IODP BDSmask GPSmask GALmask GLOmask
+   Type2: SatSlot Week Sow Tod SSRGap IODSSR IODN SatSlot IODCorr R A C URAclass URAvalue
+   Type3: SatSlot Week Sow Tod SSRGap IODSSR SatSlot CodeNum {mode bias}*8
+   Type4: SubType Week Sow Tod SSRGap IODSSR IODP SubType SatNum {IODCorr C0}*23 Week Sow
+
+   Week/Sow are the reception time in BDT. Records are stamped with the
+   reception time in GPST, as the decoded B2b messages are.
+-----------------------------------------------------------------------------*/
+static int decodeB2bType1(const char* line, b2brec_t* rec)
+{
+    static const int off[] = { 0, 63, 100, 137, MaskNSAT };
+    const char* p = line, * mask;
+    int Week, Sow, gap, i, j, len;
+
+    if (!(p = B2bint(p, &Week)) || !(p = B2bint(p, &Sow)) || !(p = B2bint(p, &rec->tod)) ||
+        !(p = B2bint(p, &gap)) || !(p = B2bint(p, &rec->iodssr)) || !(p = B2bint(p, &rec->iodp))) {
         return 0;
-    // Zero out the ephemeris structure
-    memset(&ephg, 0, sizeof(eph_t));
-    memset(&ephb, 0, sizeof(eph_t));
-    if ((fp = fopen(file, "r")) == NULL) {
-        printf("*** ERROR: open Rinex4.0 nav file failed, please check it!\n");
+    }
+    // 0~62 BDS mask, 63~99 GPS mask, 100~136 Galileo mask, 137~173 GLONASS mask
+    for (i = 0; i < 4; i++) {
+        if (!(p = B2bstr(p, &mask, &len))) return 0;
+        for (j = off[i]; j < off[i + 1]; j++) {
+            rec->mask[j] = j - off[i] < len && mask[j - off[i]] == '1';
+        }
+    }
+    rec->type = 1;
+    rec->time = bdt2gpst(bdt2time(Week, Sow));
+    return 1;
+}
+
+static int decodeB2bType2(const char* line, b2brec_t* rec)
+{
+    const char* p = line;
+    int Week, Sow, skip;
+
+    if (!(p = B2bint(p, &skip)) || !(p = B2bint(p, &Week)) || !(p = B2bint(p, &Sow)) ||
+        !(p = B2bint(p, &rec->tod)) || !(p = B2bint(p, &skip)) || !(p = B2bint(p, &rec->iodssr)) ||
+        !(p = B2bint(p, &rec->iodn)) || !(p = B2bint(p, &rec->slot)) ||
+        !(p = B2bint(p, &rec->iodcorr[0])) || !(p = B2bflt(p, &rec->val[0])) ||
+        !(p = B2bflt(p, &rec->val[1])) || !(p = B2bflt(p, &rec->val[2])) ||
+        !(p = B2bint(p, &rec->ura[0])) || !(p = B2bint(p, &rec->ura[1]))) {
+        return 0;
+    }
+    rec->type = 2;
+    rec->time = bdt2gpst(bdt2time(Week, Sow));
+    return 1;
+}
+
+static int decodeB2bType3(const char* line, b2brec_t* rec)
+{
+    const char* p = line;
+    int Week, Sow, skip, i;
+
+    if (!(p = B2bint(p, &rec->slot)) || !(p = B2bint(p, &Week)) || !(p = B2bint(p, &Sow)) ||
+        !(p = B2bint(p, &rec->tod)) || !(p = B2bint(p, &skip)) || !(p = B2bint(p, &rec->iodssr)) ||
+        !(p = B2bint(p, &skip)) || !(p = B2bint(p, &rec->n))) {
+        return 0;
+    }
+    // Code biases of 8 signals (mode, bias)
+    for (i = 0; i < 8; i++) {
+        if (!(p = B2bint(p, rec->mode + i)) || !(p = B2bflt(p, rec->val + i))) return 0;
+    }
+    if (rec->n < 0 || rec->n > 8) return 0;
+    rec->type = 3;
+    rec->time = bdt2gpst(bdt2time(Week, Sow));
+    return 1;
+}
+
+static int decodeB2bType4(const char* line, b2brec_t* rec)
+{
+    const char* p = line;
+    int Week, Sow, skip, i;
+
+    if (!(p = B2bint(p, &skip)) || !(p = B2bint(p, &Week)) || !(p = B2bint(p, &Sow)) ||
+        !(p = B2bint(p, &rec->tod)) || !(p = B2bint(p, &skip)) || !(p = B2bint(p, &rec->iodssr)) ||
+        !(p = B2bint(p, &rec->iodp)) || !(p = B2bint(p, &rec->slot)) || !(p = B2bint(p, &rec->n))) {
         return 0;
     }
-    // set system mask
-    mask = SYS_ALL;
-    // Retrieve BeiDou week from D1D2
-    while (fgets(buff, MAXRNXLEN, fp)) {
-        if ((strstr(buff, "D1") || strstr(buff, "D2")) && (strstr(buff, "> EPH"))) {
-            for (i = 0; i < 6; i++)
-            {
-                fgets(buff, MAXRNXLEN, fp);
+    // Clock corrections of 23 satellites (IODCorr, C0) followed by the reception time
+    for (i = 0; i < MAXCLOCKCOR; i++) {
+        if (!(p = B2bint(p, rec->iodcorr + i)) || !(p = B2bflt(p, rec->val + i))) return 0;
+    }
+    if (!*skipB2bfld(p)) return 0;
+    rec->type = 4;
+    rec->time = bdt2gpst(bdt2time(Week, Sow));
+    return 1;
+}
+
+/* update B2b corrections by a decoded record ---------------------------------*/
+// Set the satellite mask of B2b corrections, the slot tables are rebuilt only
+// when the mask differs from the current one
+static void setB2bmask(const unsigned char* mask, b2bsat_t* b2bsat)
+{
+    int i, sat, count = 0;
+
+    if (!memcmp(b2bsat->SatSlot, mask, sizeof(b2bsat->SatSlot))) return;
+
+    // Clear the satellite index of the last mask
+    for (i = 0; i < b2bsat->nsat; i++) {
+        if ((sat = b2bsat->sats[i]) > 0 && sat <= MAXSAT) b2bsat->index[sat - 1] = -1;
+    }
+    for (i = 0; i < MaskNSAT; ++i) {
+        // Set the slot status for the satellite and skip empty slots
+        b2bsat->SatSlot[i] = mask[i];
+        if (!mask[i]) continue;
+        sat = satSlot2Sat(i + 1);
+
+        // Store the satellite in the mask order and index
+        if (sat > 0 && sat <= MAXSAT) b2bsat->index[sat - 1] = count;
+        else sat = 0;
+        b2bsat->sats[count++] = sat;
+    }
+    // Update the number of satellites
+    b2bsat->nsat = count;
+}
+
+static void updateB2bType1(const b2brec_t* rec, b2bsat_t* b2bsat)
+{
+    B2bType1_t* type1 = b2bsat->b2btype1;
+
+    // A mask older than the current one (a replayed copy) is rejected
+    if (timediff(rec->time, type1->t0) < 0.0) return;
+
+    // If the IODP value differs from the previous, start a new generation of the
+    // corrections (the corrections of satellites are kept until updated)
+    if (type1->Iodp != rec->iodp) {
+        type1[1] = type1[0];
+        b2bsat->gen++;
+    }
+    type1->Iodp = rec->iodp;
+    type1->IodSsr = rec->iodssr;
+    type1->TodBDT = rec->tod;
+    type1->t0 = rec->time;
+
+    // A rebroadcast mask of a known IODP only updates the time stamp above
+    setB2bmask(rec->mask, b2bsat);
+}
+
+static void updateB2bType2(const b2brec_t* rec, b2bsat_t* b2bsat)
+{
+    B2bType2_t* type2;
+    int j, sat;
+
+    // Check for valid satellite slot and find the satellite in the b2bsat structure
+    if (rec->slot < 0 || rec->slot > 255) return;
+    if (B2bSatIndex(sat = satSlot2Sat(rec->slot), b2bsat) < 0) return;
+
+    // Validate IODCorr, radial (15 bits), along/cross-track (13 bits) and URA
+    if (rec->iodcorr[0] < 0 || rec->iodcorr[0] > 7) return;
+    if (fabs(rec->val[0]) - 26.2128 > 1E-6) return;
+    for (j = 1; j < 3; j++) {
+        if (fabs(rec->val[j]) - 26.208 > 1E-6) return;
+    }
+    if (rec->ura[0] < 0 || rec->ura[0] > 7 || rec->ura[1] < 0 || rec->ura[1] > 7) return;
+
+    // Corrections older than the current ones of the satellite are rejected
+    if (timediff(rec->time, b2bsat->b2bsats[sat - 1].b2btype2.t0) < 0.0) return;
+
+    type2 = &B2bSatUpdate(sat, b2bsat)->b2btype2;
+    type2->t0 = rec->time;
+    type2->IodSsr = rec->iodssr;
+    type2->TodBDT = rec->tod;
+    type2->IODN = rec->iodn;
+    type2->IodCorr = rec->iodcorr[0];
+    for (j = 0; j < 3; j++) {
+        type2->OrbCorr[j] = rec->val[j]; // 0:Radial, 1:Along-track, 2:Cross-track
+    }
+    type2->UraClass = rec->ura[0];
+    type2->UraValue = rec->ura[1];
+}
+
+static void updateB2bType3(const b2brec_t* rec, b2bsat_t* b2bsat)
+{
+    B2bType3_t* type3;
+    int i, sat;
+
+    if (rec->slot <= 0) return;
+    if (B2bSatIndex(sat = satSlot2Sat(rec->slot), b2bsat) < 0) return;
+    if (timediff(rec->time, b2bsat->b2bsats[sat - 1].b2btype3.t0) < 0.0) return;
+
+    type3 = &B2bSatUpdate(sat, b2bsat)->b2btype3;
+    for (i = 0; i < rec->n; ++i) {
+        if (rec->mode[i] < 0 || rec->mode[i] >= NMODESINGAL) continue;
+
+        // Update the B2btype3 structure for the corresponding satellite
+        type3->IodSsr = rec->iodssr;
+        type3->t0 = rec->time;
+        type3->TodBDT = rec->tod;
+        type3->SatDCB[rec->mode[i]] = rec->val[i];
+    }
+}
+
+static void updateB2bType4(const b2brec_t* rec, b2bsat_t* b2bsat)
+{
+    B2bType4_t* type4;
+    int i, j, sat;
+
+    if (rec->iodssr < 0 || rec->iodssr > 3) return;
+    if (rec->iodp < 0 || rec->iodp > 15) return;
+    if (rec->slot < 0 || rec->slot > 31) return;
+
+    j = rec->slot * MAXCLOCKCOR;
+
+    // Clock corrections for 23 satellites of the subtype:
+    // i + j = 0 to 22: First 23 satellites where the mask is set to 1
+    // i + j = 23 to 45: Next 23 satellites where the mask is set to 1, and so on
+    for (i = 0; i < MAXCLOCKCOR; ++i) {
+        if (i + j >= b2bsat->nsat) break;
+        if ((sat = b2bsat->sats[i + j]) <= 0) continue;
+
+        // IOD Corr (3 bits) and C0 (15 bits)
+        if (rec->iodcorr[i] < 0 || rec->iodcorr[i] > 7) continue;
+        if (fabs(rec->val[i]) - 27 > 1E-6) continue;
+        if (timediff(rec->time, b2bsat->b2bsats[sat - 1].b2btype4.t0) < 0.0) continue;
+
+        // Update the satellite information for the specific satellite index
+        type4 = &B2bSatUpdate(sat, b2bsat)->b2btype4;
+        type4->Iodp = rec->iodp;
+        type4->TodBDT = rec->tod;
+        type4->IodSsr = rec->iodssr;
+        type4->t0 = rec->time;
+        type4->IodCorr = rec->iodcorr[i];
+        type4->C0 = rec->val[i];
+    }
+}
+
+static int (*decodeB2b[])(const char*, b2brec_t*) = {
+    decodeB2bType1, decodeB2bType2, decodeB2bType3, decodeB2bType4
+};
+
+// Decode a B2b text record line of a message type (0: error)
+extern int decodeB2brec(const char* line, int type, b2brec_t* rec)
+{
+    if (type < 1 || type > 4) return 0;
+    return decodeB2b[type - 1](line, rec);
+}
+
+/* LSB of B2b correction values (ICD PPP-B2b 6.2-6.4) ------------------------*/
+static double lsbB2b(int type, int i)
+{
+    switch (type) {
+        case 2: return i == 0 ? 0.0016 : 0.0064; // Radial / Along-track, Cross-track
+        case 3: return 0.017;                    // Code bias
+        case 4: return 0.0016;                   // Clock correction C0
+    }
+    return 0.0;
+}
+
+// Convert B2b correction record to binary record
+static void rec2bin(const b2brec_t* rec, b2bbin_t* bin)
+{
+    double sow;
+    int i, week, nval = 0;
+
+    memset(bin, 0, sizeof(b2bbin_t));
+    sow = time2bdt(rec->time, &week);
+    bin->t = week * 604800 + (int)floor(sow + 0.5);
+    bin->tod = rec->tod;
+    bin->type = (unsigned char)rec->type;
+    bin->iodssr = (unsigned char)rec->iodssr;
+    bin->iodp = (unsigned char)rec->iodp;
+    bin->n = (unsigned char)rec->n;
+    bin->slot = (short)rec->slot;
+    bin->iodn = (short)rec->iodn;
+    bin->ura[0] = (unsigned char)rec->ura[0];
+    bin->ura[1] = (unsigned char)rec->ura[1];
+
+    switch (rec->type) {
+        case 1:
+            for (i = 0; i < MaskNSAT; i++) {
+                if (rec->mask[i]) bin->val[i / 16] |= (short)(1 << (i % 16));
             }
-            BDTWeek = (int)str2num(buff, 43, 62);
-            break;
+            return;
+        case 2: bin->iod[0] = (unsigned char)rec->iodcorr[0]; nval = 3; break;
+        case 3: for (i = 0; i < rec->n; i++) bin->iod[i] = (unsigned char)rec->mode[i]; nval = rec->n; break;
+        case 4: for (i = 0; i < MAXCLOCKCOR; i++) bin->iod[i] = (unsigned char)rec->iodcorr[i]; nval = MAXCLOCKCOR; break;
+    }
+    for (i = 0; i < nval; i++) {
+        bin->val[i] = (short)floor(rec->val[i] / lsbB2b(rec->type, i) + 0.5);
+    }
+}
+
+// Convert binary record to B2b correction record
+static void bin2rec(const b2bbin_t* bin, b2brec_t* rec)
+{
+    int i, nval = 0;
+
+    rec->time = bdt2time(bin->t / 604800, bin->t % 604800);
+    rec->type = bin->type;
+    rec->tod = bin->tod;
+    rec->iodssr = bin->iodssr;
+    rec->iodp = bin->iodp;
+    rec->n = bin->n;
+    rec->slot = bin->slot;
+    rec->iodn = bin->iodn;
+    rec->ura[0] = bin->ura[0];
+    rec->ura[1] = bin->ura[1];
+
+    switch (bin->type) {
+        case 1:
+            for (i = 0; i < MaskNSAT; i++) {
+                rec->mask[i] = ((unsigned short)bin->val[i / 16] >> (i % 16)) & 1;
+            }
+            return;
+        case 2: rec->iodcorr[0] = bin->iod[0]; nval = 3; break;
+        case 3: for (i = 0; i < bin->n; i++) rec->mode[i] = bin->iod[i]; nval = bin->n; break;
+        case 4: for (i = 0; i < MAXCLOCKCOR; i++) rec->iodcorr[i] = bin->iod[i]; nval = MAXCLOCKCOR; break;
+    }
+    for (i = 0; i < nval; i++) {
+        rec->val[i] = bin->val[i] * lsbB2b(bin->type, i);
+    }
+}
+
+// BDT seconds from BDT week 0 of the (BDT-stamped) B2b record time
+static double bdtsec(gtime_t time)
+{
+    int week;
+    double sow = time2bdt(time, &week);
+
+    return week * 604800.0 + sow;
+}
+
+// Load look-ahead B2b record of a text file
+static int loadB2brec(b2bcur_t* cur, int type)
+{
+    char line[1024];
+
+    if (!cur->fp) return 0;
+
+    while (!cur->pend) {
+        if (!fgets(line, sizeof(line), cur->fp)) return 0;
+
+        // Parse the contents of the line
+        if (!decodeB2b[type - 1](line, &cur->rec)) {
+            fprintf(stderr, "An error occurred reading the B2btype%d file\n", type);
+            continue;
         }
-        continue;
+        cur->pend = 1;
     }
-    rewind(fp);
-    // Convert epoch to time; time to GPS; or directly use toc
-    while (fgets(buff, MAXRNXLEN, fp)) {
-        i = 0;     memset(data, 0, sizeof(data));// Zero out the data array
-        if (buff[0] == '\0' || buff[0] == '\n') continue;
-        if (strstr(label, "RINEX VERSION / TYPE")) {
-            ver = str2num(buff, 0, 9);
-            type1 = *(buff + 20);
-            if (ver < 4.0)
-                return 0;
-            while (fgets(buff, MAXRNXLEN, fp)) {
-                // Header section, only store leap seconds
-                if (strstr(label, "LEAP SECONDS")) { 
-                    // Optional
-                    if (nav) nav->leaps = (int)str2num(buff, 0, 6);
-                }
-                else if (strstr(label, "END OF HEADER")) {
-                    // Read one more line to enter the body of the file
-                    fgets(buff, MAXRNXLEN, fp); break;
-                }
-                continue;
+    return 1;
+}
+
+/* read next B2b record not later than the observation time --------------------
+   The record which is beyond the observation time is kept in the cursor as
+   look-ahead and is consumed at a later epoch, so each file is read strictly
+   forward without reopening or seeking. Records of a binary container are
+   taken in place from the mapped section.
+-----------------------------------------------------------------------------*/
+static int readB2brec(b2bcur_t* cur, int type, gtime_t obstime)
+{
+    if (cur->p) {
+        if (cur->p >= cur->pe || cur->p->ta - bdtsec(obstime) > DTTOL) return 0;
+        bin2rec(cur->p++, &cur->rec);
+        return 1;
+    }
+    if (!loadB2brec(cur, type)) return 0;
+
+    // If the record is later than the observation time, keep it for the next epoch
+    if (timediff(cur->rec.time, obstime) > DTTOL) return 0;
+
+    cur->pend = 0;
+    return 1;
+}
+
+// Read next B2b record regardless of the time
+static int nextB2brec(b2bcur_t* cur, int type)
+{
+    if (cur->p) {
+        if (cur->p >= cur->pe) return 0;
+        bin2rec(cur->p++, &cur->rec);
+        return 1;
+    }
+    if (!loadB2brec(cur, type)) return 0;
+
+    cur->pend = 0;
+    return 1;
+}
+
+extern void readB2bType1(b2bcur_t* cur, nav_t* nav, gtime_t obstime)
+{
+    while (readB2brec(cur, 1, obstime)) {
+        updateB2bType1(&cur->rec, &nav->b2bsat);
+    }
+}
+
+extern void readB2bType2(b2bcur_t* cur, nav_t* nav, gtime_t obstime)
+{
+    while (readB2brec(cur, 2, obstime)) {
+        updateB2bType2(&cur->rec, &nav->b2bsat);
+    }
+}
+
+extern void readB2bType3(b2bcur_t* cur, nav_t* nav, gtime_t obstime)
+{
+    while (readB2brec(cur, 3, obstime)) {
+        updateB2bType3(&cur->rec, &nav->b2bsat);
+    }
+}
+
+extern void readB2bType4(b2bcur_t* cur, nav_t* nav, gtime_t obstime)
+{
+    while (readB2brec(cur, 4, obstime)) {
+        updateB2bType4(&cur->rec, &nav->b2bsat);
+    }
+}
+
+// Update B2b corrections by a correction record
+// (a mask or corrections older than the current ones, as a replayed copy, are rejected)
+extern int updateB2bsat(const b2brec_t* rec, b2bsat_t* b2bsat)
+{
+    switch (rec->type) {
+        case 1: updateB2bType1(rec, b2bsat); break;
+        case 2: updateB2bType2(rec, b2bsat); break;
+        case 3: updateB2bType3(rec, b2bsat); break;
+        case 4: updateB2bType4(rec, b2bsat); break;
+        default: return -1;
+    }
+    return rec->type;
+}
+
+// Update B2b corrections of navigation data by a correction record
+extern int updateB2brec(const b2brec_t* rec, nav_t* nav)
+{
+    return updateB2bsat(rec, &nav->b2bsat);
+}
+
+// Validity periods of B2b Type1-4 corrections to start a file at a time
+static const double marginB2b[] = { 0.0, MAXAGEB2b, MAXAGEB2b_CBIAS, MAXAGEB2b_CLOCK };
+
+// Apply time of a B2b text record (seconds from the BDT week 0)
+static int timeB2brec(const b2brec_t* rec)
+{
+    return (int)floor(bdtsec(rec->time) + 0.5);
+}
+
+// Read B2b text file index cached next to the file (-1: no valid index)
+static int readB2bidx(const char* file, const struct stat* st, b2bidx_t** idx)
+{
+    FILE* fp;
+    b2bidxhdr_t hdr;
+    char path[1024];
+    int n = -1;
+
+    sprintf(path, "%.1019s.idx", file);
+    if (!(fp = fopen(path, "rb"))) return -1;
+
+    // Validate the index by the size and the modification time of the file
+    if (fread(&hdr, sizeof(b2bidxhdr_t), 1, fp) == 1 && !strncmp(hdr.magic, B2BIDX_MAGIC, 8) &&
+        hdr.ver == B2BIDX_VER && hdr.tint == B2BIDX_TINT && hdr.n >= 0 &&
+        hdr.size == (long long)st->st_size && hdr.mtime == (double)st->st_mtime) {
+        if (!(*idx = (b2bidx_t*)malloc(sizeof(b2bidx_t) * (hdr.n + 1))) ||
+            (int)fread(*idx, sizeof(b2bidx_t), hdr.n, fp) != hdr.n) {
+            free(*idx); *idx = NULL;
+        }
+        else n = hdr.n;
+    }
+    fclose(fp);
+    return n;
+}
+
+// Write B2b text file index next to the file
+static void writeB2bidx(const char* file, const struct stat* st, const b2bidx_t* idx, int n)
+{
+    FILE* fp;
+    b2bidxhdr_t hdr = { 0 };
+    char path[1024];
+
+    sprintf(path, "%.1019s.idx", file);
+    if (!(fp = fopen(path, "wb"))) {
+        trace(2, "B2b index file open error: %s\n", path);
+        return;
+    }
+    strncpy(hdr.magic, B2BIDX_MAGIC, 8);
+    hdr.ver = B2BIDX_VER;
+    hdr.tint = B2BIDX_TINT;
+    hdr.n = n;
+    hdr.size = (long long)st->st_size;
+    hdr.mtime = (double)st->st_mtime;
+    fwrite(&hdr, sizeof(b2bidxhdr_t), 1, fp);
+    fwrite(idx, sizeof(b2bidx_t), n, fp);
+    if (ferror(fp)) trace(2, "B2b index file write error: %s\n", path);
+    fclose(fp);
+}
+
+// Build B2b text file index of the first record of every index interval
+static int buildB2bidx(FILE* fp, int type, b2bidx_t** idx)
+{
+    b2bidx_t* p;
+    b2brec_t rec;
+    char line[1024];
+    long long off;
+    int n = 0, nmax = 0, ta = 0, t;
+
+    for (off = ftellB2b(fp); fgets(line, sizeof(line), fp); off = ftellB2b(fp)) {
+        if (!decodeB2b[type - 1](line, &rec)) continue;
+
+        // Records are applied after all preceding ones
+        if ((t = timeB2brec(&rec)) <= ta) continue;
+        ta = t;
+        if (n > 0 && (*idx)[n - 1].ta / B2BIDX_TINT == ta / B2BIDX_TINT) continue;
+
+        if (n >= nmax) {
+            nmax = nmax <= 0 ? 1024 : nmax * 2;
+            if (!(p = (b2bidx_t*)realloc(*idx, sizeof(b2bidx_t) * nmax))) {
+                free(*idx); *idx = NULL;
+                return -1;
             }
+            *idx = p;
         }
-        // Body of the file
-        if (ver >= 4.0)
-        {
-            //if ((strstr(buff, "LNAV"))) ephg->Inmt = 0;
-            //else if ((strstr(buff, "CNVX"))) eph->Inmt = 1;
-            //else if ((strstr(buff, "D1D2"))) eph->Inmt = 2;
-            //else if ((strstr(buff, "SBAS"))) eph->Inmt = 3;
-            if ((strstr(buff, "> STO"))) {
-                //system time offset
-                strncpy(id, buff + 6, 3);
-                // Calculate the corresponding satellite number in the navigation message for RTKLIB
-                sat = satid2no(id);              
-                // Determine the satellite system based on the satellite number
-                sys = satsys(sat, NULL);    
-                for (i = 0; i < 2; i++)
-                {// Read and discard the next two lines
-                    fgets(buff, MAXRNXLEN, fp);
-                }
+        (*idx)[n].ta = ta;
+        (*idx)[n++].off = off;
+    }
+    return n;
+}
+
+/* seek B2b text file to the start time ----------------------------------------
+   The sparse index of the file (B2BIDX_TINT seconds of apply time per entry)
+   is built on the first open and cached as <file>.idx, and is rebuilt if the
+   size or the modification time of the file changes. The file is positioned
+   at the records still effective at the start time as openB2bbin() does,
+   after a binary search of the index and a scan of at most one interval.
+-----------------------------------------------------------------------------*/
+static void seekB2btxt(b2bcur_t* cur, int type, const char* file, gtime_t ts)
+{
+    struct stat st;
+    b2bidx_t* idx = NULL;
+    b2brec_t rec;
+    char line[1024];
+    long long off, pos = 0;
+    int n, lo, hi, mid, t, ta = 0;
+
+    if (stat(file, &st) || (n = readB2bidx(file, &st, &idx)) < 0) {
+        if ((n = buildB2bidx(cur->fp, type, &idx)) < 0) {
+            rewind(cur->fp);
+            return;
+        }
+        if (!stat(file, &st)) writeB2bidx(file, &st, idx, n);
+    }
+    // Last mask at or before the start time, or first correction within the period
+    t = type == 1 ? (int)floor(bdtsec(ts)) : (int)ceil(bdtsec(ts) - marginB2b[type - 1]);
+
+    for (lo = 0, hi = n; lo < hi;) {
+        mid = (lo + hi) / 2;
+        if (type == 1 ? idx[mid].ta <= t : idx[mid].ta < t) lo = mid + 1; else hi = mid;
+    }
+    if (lo > 0) pos = idx[lo - 1].off;
+    free(idx);
+
+    // Scan the interval for the record to start from
+    fseekB2b(cur->fp, pos);
+    for (off = pos; fgets(line, sizeof(line), cur->fp); off = ftellB2b(cur->fp)) {
+        if (!decodeB2b[type - 1](line, &rec)) continue;
+        if (timeB2brec(&rec) > ta) ta = timeB2brec(&rec);
+        if (type == 1 ? ta > t : ta >= t) break;
+        pos = type == 1 ? off : ftellB2b(cur->fp);
+    }
+    fseekB2b(cur->fp, pos);
+}
+
+/* open B2b correction reader --------------------------------------------------
+   INPUT:
+   reader: B2b correction reader
+   files: Type1-4 correction files {mask, orbit, code bias, clock} ("": none)
+   ts: processing start time (GPST) (ts.time==0: from the first record)
+
+   OUTPUT:
+   number of opened files
+
+   NOTE:
+   With a start time, each file is positioned by the sparse index of the
+   file (see seekB2btxt()).
+-----------------------------------------------------------------------------*/
+extern int openB2breader(b2b_reader_t* reader, char** files, gtime_t ts)
+{
+    int i, n = 0;
+
+    reader->map = NULL;
+
+    for (i = 0; i < 4; i++) {
+        reader->cur[i].fp = NULL;
+        reader->cur[i].pend = 0;
+        reader->cur[i].p = reader->cur[i].pe = NULL;
+
+        if (!*files[i]) continue;
+        if (!(reader->cur[i].fp = fopen(files[i], "r"))) {
+            fprintf(stderr, "Failed to open file B2btype%d: %s\n", i + 1, files[i]);
+            continue;
+        }
+        if (ts.time != 0) seekB2btxt(reader->cur + i, i + 1, files[i], ts);
+        n++;
+    }
+    return n;
+}
+
+// Close B2b correction reader
+extern void closeB2breader(b2b_reader_t* reader)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (reader->cur[i].fp) fclose(reader->cur[i].fp);
+        reader->cur[i].fp = NULL;
+        reader->cur[i].pend = 0;
+        reader->cur[i].p = reader->cur[i].pe = NULL;
+    }
+    if (reader->map) unmapB2bfile(reader->map, reader->size);
+    reader->map = NULL;
+    reader->size = 0;
+}
+
+// Input B2b corrections up to the observation time
+extern void inputB2breader(b2b_reader_t* reader, nav_t* nav, gtime_t obstime)
+{
+    readB2bType1(reader->cur, nav, obstime);
+    readB2bType2(reader->cur + 1, nav, obstime);
+    readB2bType3(reader->cur + 2, nav, obstime);
+    readB2bType4(reader->cur + 3, nav, obstime);
+}
+/* convert B2b correction files to binary container ----------------------------
+   INPUT:
+   files: Type1-4 correction files {mask, orbit, code bias, clock} ("": none)
+   outfile: binary container file
+
+   OUTPUT:
+   number of converted records (0: error)
+
+   NOTE:
+   The container holds a header, and for each message type a section of
+   fixed size records (b2bbin_t) in file order followed by a time index of
+   every B2BBIN_NIDX-th record apply time. The apply time is the latest
+   reference time up to the record, as the text reader applies a record only
+   after all the preceding ones. Values are quantized to the ICD LSB and
+   stored in the native byte order.
+-----------------------------------------------------------------------------*/
+extern int convB2bbin(char** files, const char* outfile)
+{
+    FILE* fp;
+    b2bbinhdr_t hdr = { 0 };
+    b2bbin_t* bins[4] = { NULL }, * p;
+    b2brec_t rec;
+    char line[1024];
+    int i, j, k, nmax, off, ntotal = 0, stat = 1;
+
+    for (i = 0; i < 4 && stat; i++) {
+        hdr.sec[i].type = i + 1;
+        if (!*files[i]) continue;
+
+        if (!(fp = fopen(files[i], "r"))) {
+            fprintf(stderr, "Failed to open file B2btype%d: %s\n", i + 1, files[i]);
+            stat = 0;
+            break;
+        }
+        for (nmax = 0; fgets(line, sizeof(line), fp);) {
+            if (!decodeB2b[i](line, &rec)) {
+                fprintf(stderr, "An error occurred reading the B2btype%d file\n", i + 1);
                 continue;
             }
-            if (strstr(buff, "> ION")) {//ionosphere      
-                strncpy(id, buff + 6, 3);
-                sat = satid2no(id);
-                sys = satsys(sat, NULL);
-                if (strstr(buff, "IFNV"))
-                {
-                    for (i = 0; i < 2; i++)
-                    {// Read and discard the next two lines
-                        fgets(buff, MAXRNXLEN, fp);
-                    }
-                    continue;
-                }
-                else
-                {
-                    for (i = 0; i < 3; i++)
-                    {// Read and discard the next three lines
-                        fgets(buff, MAXRNXLEN, fp);
-                    }
-                    continue;
+            if (hdr.sec[i].n >= nmax) {
+                nmax = nmax <= 0 ? 4096 : nmax * 2;
+                if (!(p = (b2bbin_t*)realloc(bins[i], sizeof(b2bbin_t) * nmax))) {
+                    stat = 0;
+                    break;
                 }
+                bins[i] = p;
             }
-            if ((strstr(buff, "> EOP"))) {// Earth orientation parameters
-                strncpy(id, buff + 6, 3);
-                // Calculate the corresponding satellite number in the navigation message for RTKLIB
-                sat = satid2no(id);              
-                // Determine the satellite system based on the satellite number
-                sys = satsys(sat, NULL);    
-                for (i = 0; i < 3; i++)
-                {   // Read and discard the next three lines
-                    fgets(buff, MAXRNXLEN, fp);
-                }
-                continue;
+            p = bins[i] + hdr.sec[i].n++;
+            rec2bin(&rec, p);
+
+            // Records are kept in file order and applied after all preceding ones
+            p->ta = hdr.sec[i].n > 1 && p[-1].ta > p->t ? p[-1].ta : p->t;
+        }
+        fclose(fp);
+    }
+    if (stat) {
+        strcpy(hdr.magic, B2BBIN_MAGIC);
+        hdr.ver = B2BBIN_VER;
+        hdr.nidx = B2BBIN_NIDX;
+        hdr.size = sizeof(b2bbin_t);
+
+        for (i = 0, off = sizeof(b2bbinhdr_t); i < 4; i++) {
+            hdr.sec[i].ni = (hdr.sec[i].n + B2BBIN_NIDX - 1) / B2BBIN_NIDX;
+            hdr.sec[i].off = off;
+            hdr.sec[i].ioff = off += sizeof(b2bbin_t) * hdr.sec[i].n;
+            off += sizeof(int) * hdr.sec[i].ni;
+            if (hdr.sec[i].n > 0) {
+                hdr.sec[i].ts = bins[i][0].ta;
+                hdr.sec[i].te = bins[i][hdr.sec[i].n - 1].ta;
             }
-            if ((strstr(buff, "> EPH")) && (strstr(buff, "CNV1") || strstr(buff, "LNAV"))) { // Read LNAV CNV1 ephemerides
-                strncpy(id, buff + 6, 3);
-                // Calculate the corresponding satellite number in the navigation message for RTKLIB
-                sat = satid2no(id);              
-                // Determine the satellite system based on the satellite number
-                sys = satsys(sat, NULL);    
-                if (sys == SYS_GPS || sys == SYS_CMP)
-                {
-                    //message71
-                    if ((strstr(buff, "LNAV"))) ephg.Enmt = 1;
-                    //else if ((strstr(buff, "CNAV"))) ephg->Enmt = 2;
-                    //else if ((strstr(buff, "D1")))   ephb->Enmt = 3;
-                    //else if ((strstr(buff, "D2")))   ephb->Enmt = 4;
-                    else if ((strstr(buff, "CNV1"))) ephb.Enmt = 5;//message72
-                    //else if ((strstr(buff, "CNV2"))) ephb->Enmt = 5;
-                    //else if ((strstr(buff, "CNV3"))) eph->Enmt = 6;
-                    //else if ((strstr(buff, "SBAS"))) eph->Enmt = 7;
-                    while (fgets(buff, MAXRNXLEN, fp)) { // Read ephemeris parameters
-                        if (buff[0] == '\0' || buff[0] == '\n') continue;
-                        if (i == 0) {
-                            if (str2time(buff + 4, 0, 19, &toc)) {          /* Decode time field */
-                                printf("rinex nav toc error: %23.23s\n", buff);
-                                return 0;
-                            }
-                            for (j = 0, p = buff + 4 + 19; j < 3; j++, p += 19) { /* Decode data fields */
-                                data[i++] = str2num(p, 0, 19);
-                            }
-                        }
-                        else
-                        {
-                            for (j = 0, p = buff + 4; j < 4; j++, p += 19) {       /* Decode subsequent data fields */
-                                data[i++] = str2num(p, 0, 19);
-                            }
-                            if ((ephg.Enmt == 1) && i >= 29) { // LNAV D1D2 together contains 31 data points
-                                LD = decode_LDeph(sat, toc, data, &ephg);
-                                if (LD)
-                                {
-                                    add_eph(nav, &ephg);
-                                }
-                                break;
-                            }
-                            else if ((ephb.Enmt == 5) && i >= 39) { // CNV1 CNV2 together contains 39 data points 
-                                CNV = decode_CNVeph(sat, toc, data, &ephb);
-                                if (CNV)
-                                {
-                                    add_eph(nav, &ephb);
-                                }
-                                break;
-                            }
-                        }
-                    }
+        }
+        if (!(fp = fopen(outfile, "wb"))) {
+            fprintf(stderr, "Failed to open file B2b container: %s\n", outfile);
+            stat = 0;
+        }
+    }
+    if (stat) {
+        fwrite(&hdr, sizeof(b2bbinhdr_t), 1, fp);
+
+        for (i = 0; i < 4; i++) {
+            fwrite(bins[i], sizeof(b2bbin_t), hdr.sec[i].n, fp);
+
+            for (j = k = 0; j < hdr.sec[i].ni; j++, k += B2BBIN_NIDX) {
+                fwrite(&bins[i][k].ta, sizeof(int), 1, fp);
+            }
+            ntotal += hdr.sec[i].n;
+        }
+        if (ferror(fp)) stat = 0;
+        fclose(fp);
+    }
+    for (i = 0; i < 4; i++) free(bins[i]);
+
+    return stat ? ntotal : 0;
+}
+
+/* search first binary record applied at or after the time --------------------
+   The time index narrows the search to B2BBIN_NIDX records which are then
+   searched in place, so only O(log n) records of the mapping are touched.
+-----------------------------------------------------------------------------*/
+static const b2bbin_t* searchB2bbin(const b2bbin_t* p, int n, const int* idx, int ni,
+    int nidx, int t)
+{
+    int lo = 0, hi = ni, mid;
+
+    // First index entry at or after the time
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (idx[mid] < t) lo = mid + 1; else hi = mid;
+    }
+    hi = lo * nidx < n ? lo * nidx : n;
+    lo = lo > 0 ? (lo - 1) * nidx : 0;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (p[mid].ta < t) lo = mid + 1; else hi = mid;
+    }
+    return p + lo;
+}
+
+/* open B2b binary correction container -----------------------------------------
+   INPUT:
+   reader: B2b correction reader
+   file: binary container file
+   ts: processing start time (GPST) (ts.time==0: from the first record)
+
+   OUTPUT:
+   status (1:ok, 0:error)
+
+   NOTE:
+   With a start time, each section starts at the records still effective at
+   that time: the last Type1 mask, and Type2/Type3/Type4 corrections within
+   their validity periods.
+-----------------------------------------------------------------------------*/
+extern int openB2bbin(b2b_reader_t* reader, const char* file, gtime_t ts)
+{
+    const b2bbinhdr_t* hdr;
+    const b2bbinsec_t* sec;
+    const b2bbin_t* p;
+    const char* map;
+    int i, t;
+
+    for (i = 0; i < 4; i++) {
+        reader->cur[i].fp = NULL;
+        reader->cur[i].pend = 0;
+        reader->cur[i].p = reader->cur[i].pe = NULL;
+    }
+    reader->size = 0;
+
+    if (!(reader->map = mapB2bfile(file, &reader->size))) {
+        fprintf(stderr, "Failed to open file B2b container: %s\n", file);
+        return 0;
+    }
+
+    map = (const char*)reader->map;
+    hdr = (const b2bbinhdr_t*)map;
+
+    // Validate the header and the section extents
+    if (reader->size < sizeof(b2bbinhdr_t) || strncmp(hdr->magic, B2BBIN_MAGIC, 8) ||
+        hdr->ver != B2BBIN_VER || hdr->size != sizeof(b2bbin_t) || hdr->nidx <= 0) {
+        fprintf(stderr, "Invalid B2b container: %s\n", file);
+        closeB2breader(reader);
+        return 0;
+    }
+    for (i = 0; i < 4; i++) {
+        sec = hdr->sec + i;
+        if (sec->n < 0 || sec->off < 0 || sec->ioff < 0 ||
+            sec->off + (size_t)sec->n * sizeof(b2bbin_t) > reader->size ||
+            sec->ioff + (size_t)sec->ni * sizeof(int) > reader->size ||
+            sec->ni != (sec->n + hdr->nidx - 1) / hdr->nidx) {
+            fprintf(stderr, "Invalid B2b container: %s\n", file);
+            closeB2breader(reader);
+            return 0;
+        }
+    }
+    for (i = 0; i < 4; i++) {
+        sec = hdr->sec + i;
+        p = (const b2bbin_t*)(map + sec->off);
+        reader->cur[i].p = p;
+        reader->cur[i].pe = p + sec->n;
+
+        if (ts.time == 0 || sec->n <= 0) continue;
+
+        if (i == 0) {
+            // Last mask at or before the start time
+            t = (int)floor(bdtsec(ts)) + 1;
+            p = searchB2bbin(p, sec->n, (const int*)(map + sec->ioff), sec->ni, hdr->nidx, t);
+            reader->cur[i].p = p > reader->cur[i].p ? p - 1 : p;
+        }
+        else {
+            t = (int)ceil(bdtsec(ts) - marginB2b[i]);
+            reader->cur[i].p = searchB2bbin(p, sec->n, (const int*)(map + sec->ioff), sec->ni,
+                hdr->nidx, t);
+        }
+    }
+    return 1;
+}
+/* check CRC-24Q of B2b message ------------------------------------------------
+   The CRC covers the message type and data (462 bits) which are right aligned
+   to 58 bytes with 2 leading zero bits.
+-----------------------------------------------------------------------------*/
+static int checkB2bcrc(const unsigned char* msg)
+{
+    unsigned char buff[58];
+    int i;
+
+    buff[0] = msg[0] >> 2;
+    for (i = 1; i < 58; i++) {
+        buff[i] = (unsigned char)((msg[i - 1] << 6) | (msg[i] >> 2));
+    }
+    return rtk_crc24q(buff, 58) == getbitu(msg, 462, 24);
+}
+
+// Decode B2b message to correction records (one per satellite for Type2/Type3)
+static int decodeB2bframe(const b2bmsg_t* msg, b2brec_t* recs, int* nrec)
+{
+    const unsigned char* p = msg->msg;
+    b2brec_t rec = { 0 };
+    int i, j, type, nsat, pos;
+
+    *nrec = 0;
+
+    if (!checkB2bcrc(p)) {
+        trace(2, "B2b message CRC error: prn=%d\n", msg->prn);
+        return -1;
+    }
+    type = getbitu(p, 0, 6);
+    rec.type = type;
+    rec.tod = getbitu(p, 6, 17);
+    rec.iodssr = getbitu(p, 27, 2);
+    rec.time = gpst2time(msg->week, msg->tow);
+
+    trace(4, "decodeB2bframe: type=%d prn=%d tod=%d\n", type, msg->prn, rec.tod);
+
+    switch (type) {
+        case 1: // Satellite mask
+            rec.iodp = getbitu(p, 29, 4);
+            for (i = 0; i < MaskNSAT; i++) rec.mask[i] = (unsigned char)getbitu(p, 33 + i, 1);
+            recs[(*nrec)++] = rec;
+            break;
+        case 2: // Orbit corrections and URA of 6 satellites
+            for (i = 0, pos = 29; i < MAXORBITCOR - 1; i++, pos += 69) {
+                if (!(rec.slot = getbitu(p, pos, 9))) continue;
+                rec.iodn = getbitu(p, pos + 9, 10);
+                rec.iodcorr[0] = getbitu(p, pos + 19, 3);
+                rec.val[0] = getbits(p, pos + 22, 15) * 0.0016;
+                rec.val[1] = getbits(p, pos + 37, 13) * 0.0064;
+                rec.val[2] = getbits(p, pos + 50, 13) * 0.0064;
+                rec.ura[0] = getbitu(p, pos + 63, 3);
+                rec.ura[1] = getbitu(p, pos + 66, 3);
+                recs[(*nrec)++] = rec;
+            }
+            break;
+        case 3: // Code biases
+            nsat = getbitu(p, 29, 5);
+            for (i = 0, pos = 34; i < nsat && pos + 13 <= 462; i++) {
+                rec.slot = getbitu(p, pos, 9);
+                rec.n = getbitu(p, pos + 9, 4);
+                pos += 13;
+                if (pos + rec.n * 16 > 462) break;
+                for (j = 0; j < rec.n; j++, pos += 16) {
+                    rec.mode[j] = getbitu(p, pos, 4);
+                    rec.val[j] = getbits(p, pos + 4, 12) * 0.017;
                 }
+                recs[(*nrec)++] = rec;
             }
+            break;
+        case 4: // Clock corrections of 23 satellites
+            rec.iodp = getbitu(p, 29, 4);
+            rec.slot = getbitu(p, 33, 5);
+            rec.n = MAXCLOCKCOR;
+            for (i = 0, pos = 38; i < MAXCLOCKCOR; i++, pos += 18) {
+                rec.iodcorr[i] = getbitu(p, pos, 3);
+                rec.val[i] = getbits(p, pos + 3, 15) * 0.0016;
+            }
+            recs[(*nrec)++] = rec;
+            break;
+        default:
+            trace(3, "unsupported B2b message: type=%d\n", type);
+            return -1;
+    }
+    return type;
+}
+
+/* decode B2b message ----------------------------------------------------------
+   INPUT:
+   msg: B2b message (486 bits, reception time in GPST)
+   nav: navigation data with B2b corrections
+   b2bsat: B2b corrections
+
+   OUTPUT:
+   message type (-1: error or unsupported message)
+
+   NOTE:
+   Corrections are stamped with the reception time (GPST) as the records of the
+   B2b text files. decodeB2bsat() updates a correction set apart from
+   navigation data.
+-----------------------------------------------------------------------------*/
+extern int decodeB2bsat(const b2bmsg_t* msg, b2bsat_t* b2bsat)
+{
+    b2brec_t recs[MAXCODECOR];
+    int i, type, nrec;
+
+    if ((type = decodeB2bframe(msg, recs, &nrec)) < 0) return -1;
+
+    for (i = 0; i < nrec; i++) {
+        updateB2bsat(recs + i, b2bsat);
+    }
+    return type;
+}
+
+// Decode B2b message to the corrections of navigation data
+extern int decodeB2bmsg(const b2bmsg_t* msg, nav_t* nav)
+{
+    return decodeB2bsat(msg, &nav->b2bsat);
+}
+
+/* input B2b messages up to the observation time -------------------------------
+   INPUT:
+   b2b: B2b messages sorted by reception time
+   index: index of next message (updated)
+   nav: navigation data with B2b corrections
+   obstime: observation time (GPST)
+
+   OUTPUT:
+   number of decoded messages
+-----------------------------------------------------------------------------*/
+extern int inputB2bmsg(const b2b_t* b2b, int* index, nav_t* nav, gtime_t obstime)
+{
+    const b2bmsg_t* msg;
+    int n = 0;
+
+    for (; *index < b2b->n; (*index)++) {
+        msg = b2b->msgs + *index;
+        if (timediff(gpst2time(msg->week, msg->tow), obstime) > DTTOL) break;
+        if (decodeB2bmsg(msg, nav) > 0) n++;
+    }
+    return n;
+}
+
+/* B2b correction timeline -----------------------------------------------------
+   The updates of a correction are kept in columns (apply time, sequence
+   number, generation and correction data) sorted by the apply time, so the
+   search of an epoch only touches the time column.
+-----------------------------------------------------------------------------*/
+// Find the latest update of a B2b timeline not later than the time (-1: none)
+static int seekB2bline(b2bline_t* line, gtime_t time)
+{
+    int i = line->i < line->n ? line->i : line->n - 1, j, lo = 0, hi = line->n, mid;
+
+    // Sequential epochs stay at the last update or advance by a few updates
+    if (i >= 0 && timediff(line->time[i], time) <= DTTOL) {
+        for (j = 0; j < 4; j++, i++) {
+            if (i + 1 >= line->n || timediff(line->time[i + 1], time) > DTTOL) {
+                return line->i = i;
+            }
+        }
+        lo = i + 1;
+    }
+    else if (i >= 0) hi = i;
+
+    // Binary search of the apply times
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (timediff(line->time[mid], time) <= DTTOL) lo = mid + 1; else hi = mid;
+    }
+    return line->i = lo - 1;
+}
+
+// Find the latest update of a B2b timeline before the update sequence number
+static int prevB2bline(const b2bline_t* line, int i, int seq)
+{
+    while (i >= 0 && line->seq[i] >= seq) i--;
+    return i;
+}
+
+// Get the correction data of an update of a B2b timeline
+static const void* dataB2bline(const b2bline_t* line, size_t size, int i)
+{
+    return (const char*)line->data + size * i;
+}
+
+// Add an update to a B2b timeline
+static int addB2bline(b2bline_t* line, size_t size, gtime_t time, int seq, int gen,
+    const void* data)
+{
+    gtime_t* t;
+    int* s, * g;
+    void* d;
+    int nmax = line->nmax <= 0 ? 256 : line->nmax * 2;
+
+    if (line->n >= line->nmax) {
+        if ((t = (gtime_t*)realloc(line->time, sizeof(gtime_t) * nmax))) line->time = t;
+        if ((s = (int*)realloc(line->seq, sizeof(int) * nmax))) line->seq = s;
+        if ((g = (int*)realloc(line->gen, sizeof(int) * nmax))) line->gen = g;
+        if ((d = realloc(line->data, size * nmax))) line->data = d;
+
+        if (!t || !s || !g || !d) {
+            trace(1, "B2b timeline memory allocation error: n=%d\n", nmax);
+            return 0;
+        }
+        line->nmax = nmax;
+    }
+    line->time[line->n] = time;
+    line->seq[line->n] = seq;
+    line->gen[line->n] = gen;
+    memcpy((char*)line->data + size * line->n++, data, size);
+    return 1;
+}
+
+// Free a B2b timeline
+static void freeB2bline(b2bline_t* line)
+{
+    free(line->time); line->time = NULL;
+    free(line->seq); line->seq = NULL;
+    free(line->gen); line->gen = NULL;
+    free(line->data); line->data = NULL;
+    line->n = line->nmax = 0;
+    line->i = -1;
+}
+
+// Add a B2b correction record to the history
+static int addB2bhis(b2bhis_t* his, const b2brec_t* rec, gtime_t time)
+{
+    b2bsat_t* b2bsat = &his->b2bsat;
+    b2bsatp_t pres[MAXCLOCKCOR];
+    const b2bsatp_t* b2bsatp;
+    const b2bhmask_t* pre;
+    b2bhsat_t* hsat;
+    b2bhmask_t mask;
+    int i, n = 0, seq, sat, sats[MAXCLOCKCOR], stat = 1;
+
+    // Satellites of which the corrections may be updated by the record
+    switch (rec->type) {
+        case 1: break;
+        case 2:
+        case 3:
+            if (B2bSatIndex(sat = satSlot2Sat(rec->slot), b2bsat) >= 0) sats[n++] = sat;
+            break;
+        case 4:
+            if (rec->slot < 0 || rec->slot > 31) break;
+            for (i = 0; i < MAXCLOCKCOR; i++) {
+                sat = B2bSubtype2Sat(rec->slot * MAXCLOCKCOR + i, b2bsat);
+                if (sat > 0) sats[n++] = sat;
+            }
+            break;
+        default: return 1;
+    }
+    for (i = 0; i < n; i++) pres[i] = b2bsat->b2bsats[sats[i] - 1];
+
+    switch (rec->type) {
+        case 1: updateB2bType1(rec, b2bsat); break;
+        case 2: updateB2bType2(rec, b2bsat); break;
+        case 3: updateB2bType3(rec, b2bsat); break;
+        case 4: updateB2bType4(rec, b2bsat); break;
+    }
+    seq = ++his->seq;
+
+    if (rec->type == 1) {
+        i = his->mask.n - 1;
+
+        // Keep the start of the generation and the last mask of the previous one
+        if (i >= 0 && his->mask.gen[i] == b2bsat->gen) {
+            pre = (const b2bhmask_t*)dataB2bline(&his->mask, sizeof(b2bhmask_t), i);
+            mask.gseq = pre->gseq;
+            mask.ipre = pre->ipre;
+        }
+        else {
+            mask.gseq = seq;
+            mask.ipre = i;
+        }
+        mask.type1 = b2bsat->b2btype1[0];
+        memcpy(mask.mask, rec->mask, sizeof(mask.mask));
+        return addB2bline(&his->mask, sizeof(b2bhmask_t), time, seq, b2bsat->gen, &mask);
+    }
+    // Add the corrections of satellites updated by the record
+    for (i = 0; i < n && stat; i++) {
+        b2bsatp = b2bsat->b2bsats + sats[i] - 1;
+        if (!memcmp(pres + i, b2bsatp, sizeof(b2bsatp_t))) continue;
+
+        hsat = his->sat + sats[i] - 1;
+
+        switch (rec->type) {
+            case 2:
+                stat = addB2bline(&hsat->orb, sizeof(B2bType2_t), time, seq, b2bsatp->gen,
+                    &b2bsatp->b2btype2);
+                break;
+            case 3:
+                stat = addB2bline(&hsat->dcb, sizeof(B2bType3_t), time, seq, b2bsatp->gen,
+                    &b2bsatp->b2btype3);
+                break;
+            case 4:
+                stat = addB2bline(&hsat->clk, sizeof(B2bType4_t), time, seq, b2bsatp->gen,
+                    &b2bsatp->b2btype4);
+                break;
         }
     }
-    fclose(fp); return 1;
+    return stat;
 }
 
-// Initialize B2b satellite data structure
-extern  initB2b(nav_t* navs)
+// Set B2b corrections of a satellite from the timelines (index -1: none)
+static void setB2bhis(const b2bhsat_t* hsat, int iorb, int idcb, int iclk,
+    b2bsatp_t* b2bsatp)
 {
-    int i, j;
+    int seq = -1;
 
-    // Initialize current epoch B2b data
-    navs->b2bsat.nsat = 0;
-    for (i = 0; i < MaskNSAT; i++) {
-        navs->b2bsat.SatSlot[i] = 0;
+    initB2bsatp(b2bsatp);
+
+    // The generation of the corrections is that of the last update
+    if (iorb >= 0) {
+        b2bsatp->b2btype2 = *(const B2bType2_t*)dataB2bline(&hsat->orb, sizeof(B2bType2_t), iorb);
+        seq = hsat->orb.seq[iorb];
+        b2bsatp->gen = hsat->orb.gen[iorb];
     }
-    for (i = 0; i < MAXSAT; i++) {
-        navs->b2bsat.b2bsats[i].sat = -1;
-
-        // B2b Type1 Initialization
-        navs->b2bsat.b2bsats[i].b2btype1.Iodp = -1;
-        navs->b2bsat.b2bsats[i].b2btype1.iB2b = -1;
-        navs->b2bsat.b2bsats[i].b2btype1.IodSsr = -1;
-        navs->b2bsat.b2bsats[i].b2btype1.t0.time = 0;
-        navs->b2bsat.b2bsats[i].b2btype1.t0.sec = 0;
-        navs->b2bsat.b2bsats[i].b2btype1.TodBDT = 0.0;
-
-        // B2b Type2 Initialization
-        navs->b2bsat.b2bsats[i].b2btype2.IodSsr = -1;
-        navs->b2bsat.b2bsats[i].b2btype2.IODN = -1;
-        navs->b2bsat.b2bsats[i].b2btype2.iB2b = -1;
-        navs->b2bsat.b2bsats[i].b2btype2.UraClass = -1;
-        navs->b2bsat.b2bsats[i].b2btype2.UraValue = -1;
-        navs->b2bsat.b2bsats[i].b2btype2.IodCorr = -1;
-        navs->b2bsat.b2bsats[i].b2btype2.t0.time = 0;
-        navs->b2bsat.b2bsats[i].b2btype2.t0.sec = 0;
-        navs->b2bsat.b2bsats[i].b2btype2.TodBDT = 0.0;
-        for (j = 0; j < 3; j++) {
-            navs->b2bsat.b2bsats[i].b2btype2.OrbCorr[j] = 0.0;
+    if (idcb >= 0) {
+        b2bsatp->b2btype3 = *(const B2bType3_t*)dataB2bline(&hsat->dcb, sizeof(B2bType3_t), idcb);
+        if (hsat->dcb.seq[idcb] > seq) {
+            seq = hsat->dcb.seq[idcb];
+            b2bsatp->gen = hsat->dcb.gen[idcb];
         }
-
-        // B2b Type3 Initialization
-        navs->b2bsat.b2bsats[i].b2btype3.TodBDT = 0.0;
-        navs->b2bsat.b2bsats[i].b2btype3.IodSsr = -1;
-        navs->b2bsat.b2bsats[i].b2btype3.iB2b = -1;
-        navs->b2bsat.b2bsats[i].b2btype3.t0.time = 0;
-        navs->b2bsat.b2bsats[i].b2btype3.t0.sec = 0;
-        for (j = 0; j < NMODESINGAL; j++) {
-            navs->b2bsat.b2bsats[i].b2btype3.SatDCB[j] = 0.0;
+    }
+    if (iclk >= 0) {
+        b2bsatp->b2btype4 = *(const B2bType4_t*)dataB2bline(&hsat->clk, sizeof(B2bType4_t), iclk);
+        if (hsat->clk.seq[iclk] > seq) {
+            b2bsatp->gen = hsat->clk.gen[iclk];
         }
-
-        // B2b Type4 Initialization
-        navs->b2bsat.b2bsats[i].b2btype4.C0 = 0.0;
-        navs->b2bsat.b2bsats[i].b2btype4.IodSsr = -1;
-        navs->b2bsat.b2bsats[i].b2btype4.Iodp = -1;
-        navs->b2bsat.b2bsats[i].b2btype4.IodCorr = -1;
-        navs->b2bsat.b2bsats[i].b2btype4.TodBDT = 0.0;
-        navs->b2bsat.b2bsats[i].b2btype4.t0.time = 0;
-        navs->b2bsat.b2bsats[i].b2btype4.t0.sec = 0;
-        navs->b2bsat.b2bsats[i].b2btype4.iB2b = -1;
     }
+}
 
-    // Initialize previous epoch B2b data
-    navs->b2bsat_pre.nsat = 0;
-    for (i = 0; i < MaskNSAT; i++) {
-        navs->b2bsat_pre.SatSlot[i] = 0;
+// Set IODP/IODSSR of the generation of B2b corrections of a satellite by the masks
+static void genB2bhis(const b2bhis_t* his, b2bsatp_t* b2bsatp)
+{
+    const B2bType1_t* type1;
+    int lo = 0, hi = his->mask.n, mid;
+
+    if (b2bsatp->gen < 0) return;
+
+    // The generations of the mask timeline are in ascending order
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (his->mask.gen[mid] < b2bsatp->gen) lo = mid + 1; else hi = mid;
     }
-    for (i = 0; i < MAXSAT; i++) {
-        navs->b2bsat_pre.b2bsats[i].sat = -1;
-
-        navs->b2bsat_pre.b2bsats[i].b2btype1.Iodp = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype1.iB2b = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype1.IodSsr = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype1.t0.time = 0;
-        navs->b2bsat_pre.b2bsats[i].b2btype1.t0.sec = 0;
-        navs->b2bsat_pre.b2bsats[i].b2btype1.TodBDT = 0.0;
-
-        navs->b2bsat_pre.b2bsats[i].b2btype2.IodSsr = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype2.IODN = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype2.iB2b = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype2.UraClass = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype2.UraValue = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype2.IodCorr = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype2.t0.time = 0;
-        navs->b2bsat_pre.b2bsats[i].b2btype2.t0.sec = 0;
-        navs->b2bsat_pre.b2bsats[i].b2btype2.TodBDT = 0.0;
-        for (j = 0; j < 3; j++) {
-            navs->b2bsat_pre.b2bsats[i].b2btype2.OrbCorr[j] = 0.0;
-        }
+    if (lo >= his->mask.n || his->mask.gen[lo] != b2bsatp->gen) return;
+    type1 = &((const b2bhmask_t*)dataB2bline(&his->mask, sizeof(b2bhmask_t), lo))->type1;
+    b2bsatp->iodp = type1->Iodp;
+    b2bsatp->iodssr = type1->IodSsr;
+}
 
-        navs->b2bsat_pre.b2bsats[i].b2btype3.TodBDT = 0.0;
-        navs->b2bsat_pre.b2bsats[i].b2btype3.IodSsr = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype3.iB2b = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype3.t0.time = 0;
-        navs->b2bsat_pre.b2bsats[i].b2btype3.t0.sec = 0;
-        for (j = 0; j < NMODESINGAL; j++) {
-            navs->b2bsat_pre.b2bsats[i].b2btype3.SatDCB[j] = 0.0;
+typedef struct {        /* B2b correction file loader type */
+    b2bcur_t* cur;      /* file cursor */
+    int type;           /* message type (1-4) */
+    int n, nmax;        /* number of records / max allocated */
+    int stat;           /* status (0: memory allocation error) */
+    b2brec_t* recs;     /* loaded records */
+} b2bload_t;
+
+/* B2b correction file loader thread -----------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI loadB2bthread(void* arg)
+#else
+static void* loadB2bthread(void* arg)
+#endif
+{
+    b2bload_t* load = (b2bload_t*)arg;
+    b2brec_t* recs;
+
+    while (nextB2brec(load->cur, load->type)) {
+        if (load->n >= load->nmax) {
+            load->nmax = load->nmax <= 0 ? 4096 : load->nmax * 2;
+            if (!(recs = (b2brec_t*)realloc(load->recs, sizeof(b2brec_t) * load->nmax))) {
+                load->stat = 0;
+                break;
+            }
+            load->recs = recs;
         }
-
-        navs->b2bsat_pre.b2bsats[i].b2btype4.C0 = 0.0;
-        navs->b2bsat_pre.b2bsats[i].b2btype4.IodSsr = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype4.Iodp = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype4.IodCorr = -1;
-        navs->b2bsat_pre.b2bsats[i].b2btype4.TodBDT = 0.0;
-        navs->b2bsat_pre.b2bsats[i].b2btype4.t0.time = 0;
-        navs->b2bsat_pre.b2bsats[i].b2btype4.t0.sec = 0;
-        navs->b2bsat_pre.b2bsats[i].b2btype4.iB2b = -1;
+        load->recs[load->n++] = load->cur->rec;
     }
+    return 0;
 }
 
-// Get satellite number from subtype index
-extern int B2bSubtype2Sat(const int ind, b2bsat_t* b2bsat)
+// Load B2b records of the correction files in parallel (0: error)
+static int loadB2brecs(b2bcur_t* cur, b2bload_t* load)
 {
-    int i, count = 0, sat = -1;
+    thread_t thread[4];
+    int i, stat[4] = { 0 };
 
-    for (i = 0; i < MaskNSAT; i++) {
-        if (b2bsat->SatSlot[i]) {
-            count++;
+    for (i = 0; i < 4; i++) {
+        load[i].cur = cur + i;
+        load[i].type = i + 1;
+        load[i].n = load[i].nmax = 0;
+        load[i].stat = 1;
+        load[i].recs = NULL;
+    }
+    // Records of the binary container are taken in place from the mapped section
+    if (cur->p) {
+        for (i = 0; i < 4; i++) loadB2bthread(load + i);
+    }
+    else {
+        for (i = 0; i < 4; i++) {
+#ifdef WIN32
+            stat[i] = (thread[i] = CreateThread(NULL, 0, loadB2bthread, load + i, 0, NULL)) != NULL;
+#else
+            stat[i] = !pthread_create(thread + i, NULL, loadB2bthread, load + i);
+#endif
+            if (!stat[i]) loadB2bthread(load + i);
         }
-        if (count == ind + 1) {
-            sat = satSlot2Sat(i + 1);
-            return sat;
+        for (i = 0; i < 4; i++) {
+            if (!stat[i]) continue;
+#ifdef WIN32
+            WaitForSingleObject(thread[i], INFINITE);
+            CloseHandle(thread[i]);
+#else
+            pthread_join(thread[i], NULL);
+#endif
+        }
+    }
+    for (i = 0; i < 4; i++) {
+        if (!load[i].stat) {
+            trace(1, "B2b record memory allocation error: type=%d\n", i + 1);
+            return 0;
         }
     }
-    return -1; // Not found
+    return 1;
 }
 
+/* build B2b correction history ------------------------------------------------
+   INPUT:
+   his: B2b correction history (freed before building)
+   reader: B2b correction reader (records are consumed)
+   b2b: B2b messages sorted by reception time (NULL: none)
 
-extern void readB2bType1(FILE* fp, b2bsat_t* b2bsat, b2bsat_t* b2bsat_pre, gtime_t obstime)
+   OUTPUT:
+   number of added records (-1: memory allocation error)
+
+   NOTE:
+   The correction files are loaded in parallel threads, then the records of
+   all the sources are applied in the order of the apply time, as
+   inputB2breader() and inputB2bmsg() do. The corrections of a satellite are
+   recorded with the apply time on each update. The history is built once and
+   is queried at any epoch in either direction by inputB2bhis().
+-----------------------------------------------------------------------------*/
+extern int buildB2bhis(b2bhis_t* his, b2b_reader_t* reader, const b2b_t* b2b)
 {
-    static long last_file_pos = 0; // Static variable to store the position of the last read in the file
-    int Week, Sow, Tod, SSRGap, IODSSR, IODP, i = 0, slot = 0, count = 0, t1 = 0;
-    char bdsmask[211], gpsmask[211], galmask[211], glomask[211];
-    gtime_t time = { 0 };
-
-    // Check if the file pointer is valid
-    if (!fp) {
-        perror("Failed to open file B2btype1");
-        exit(EXIT_FAILURE);
-    }
+    b2bload_t load[4];
+    b2brec_t recs[MAXCODECOR];
+    gtime_t ta[4] = { { 0 } }, time = { 0 };
+    int i, k, irecs[4] = { 0 }, nrec = 0, irec = 0, imsg = 0, nmsg = b2b ? b2b->n : 0;
+    int n = 0, stat = 1;
 
-    // If there is a saved position from the last read, seek to that position to resume reading from there
-    if (last_file_pos != 0) {
-        if (fseek(fp, last_file_pos, SEEK_SET) != 0) {
-            perror("Failed to seek to last position");
-            exit(EXIT_FAILURE);
-        }
-    }
-    char line[512];
+    trace(3, "buildB2bhis:\n");
 
-    // Read the file line by line
-    while (fgets(line, sizeof(line), fp)) {
-        // Record the starting position of the current line at the beginning of each loop
-        long current_line_pos = ftell(fp) - strlen(line);
+    freeB2bhis(his);
+    initB2bsat(&his->b2bsat);
 
+    if (!loadB2brecs(reader->cur, load)) stat = 0;
 
-        // Parse the contents of the line
-        if (sscanf(line, "%d %d %d %d %d %d %s %s %s %s %s", &Week, &Sow, &Tod, &SSRGap, &IODSSR, &IODP, bdsmask, gpsmask, galmask, glomask) != 10) {
-            fprintf(stderr, "An error occurred reading the B2btype1 file\n");
-            continue;
+    for (i = 0; i < 4; i++) {
+        if (load[i].n > 0) ta[i] = load[i].recs[0].time;
+    }
+    while (stat) {
+        // Decode records of the next message
+        while (irec >= nrec && imsg < nmsg) {
+            time = gpst2time(b2b->msgs[imsg].week, b2b->msgs[imsg].tow);
+            if (decodeB2bframe(b2b->msgs + imsg++, recs, &nrec) < 0) nrec = 0;
+            irec = 0;
         }
-        // If the IODP value differs from the previous, update the b2bsat_pre structure
-        if (b2bsat->b2bsats->b2btype1.Iodp != IODP)
-        {
-            memcpy(b2bsat_pre, b2bsat, sizeof(b2bsat_t));
+        // Select the record of the earliest apply time
+        for (i = 0, k = -1; i < 4; i++) {
+            if (irecs[i] < load[i].n && (k < 0 || timediff(ta[i], ta[k]) < 0.0)) k = i;
         }
-        // Convert the week and seconds of week into BDT time
-        time = bdt2time(Week, Sow+14);
-
-        double ep[6];
-        time2epoch(time, ep);
-        // If the time difference is greater than a tolerance (DTTOL), save the file position and break the loop
-        if (timediff(time, obstime) > DTTOL) // Save the file position of this line for the next read
-        {
-            last_file_pos = current_line_pos;
-            break;
+        if (irec < nrec && (k < 0 || timediff(time, ta[k]) < 0.0)) {
+            stat = addB2bhis(his, recs + irec++, time);
         }
-       
-        // Process the satellite masks for different satellite systems
-        // 0~62 BDS mask, 63~99 GPS mask, 100~136 Galileo mask, 137~173 GLONASS mask
-        for (i = 0; i < MaskNSAT; ++i) {
-            if (i <= 62)
-            {
-                slot = bdsmask[i] == '1' ? 1 : 0;
-            }
-            else if (i <= 99)
-            {
-                slot = gpsmask[i - 63] == '1' ? 1 : 0;
-            }
-            else if (i <= 136)
-            {
-                slot = galmask[i - 100] == '1' ? 1 : 0;
-            }
-            else if (i <= 173)
-            {
-                slot = glomask[i - 137] == '1' ? 1 : 0;
-            }
-            else {
-                slot = 0; // Invalid index.
-            }
-            // Set the slot status for the satellite
-            b2bsat->SatSlot[i] = slot;
-            // Skip if the slot is empty (0)
-            if (!slot) continue;
-            if (slot < 0 || slot>1) {
-                continue;
+        else if (k >= 0) {
+            stat = addB2bhis(his, load[k].recs + irecs[k]++, ta[k]);
 
+            // A record is applied after all the preceding ones of the file
+            if (irecs[k] < load[k].n && timediff(load[k].recs[irecs[k]].time, ta[k]) > 0.0) {
+                ta[k] = load[k].recs[irecs[k]].time;
             }
-            // Store the satellite information in the b2bsats array
-            b2bsat->b2bsats[count].sat = satSlot2Sat(i + 1);
-            b2bsat->b2bsats[count].b2btype1.Iodp = IODP;
-            b2bsat->b2bsats[count].b2btype1.IodSsr = IODSSR;
-            b2bsat->b2bsats[count].b2btype1.TodBDT = Tod;
-            //b2bsat->b2bsats[count].b2btype1.iB2b = msg->iB2b;
-            b2bsat->b2bsats[count++].b2btype1.t0 = time;
         }
-        // Update the number of satellites
-        b2bsat->nsat = count;
+        else break;
+        n++;
     }
+    for (i = 0; i < 4; i++) free(load[i].recs);
 
-    fclose(fp);
-
+    trace(3, "buildB2bhis: nrec=%d nmask=%d\n", n, his->mask.n);
+    return stat ? n : -1;
 }
 
-extern void readB2bType2(FILE* fp, b2bsat_t* b2bsat, gtime_t obstime)
+/* input B2b corrections from history ------------------------------------------
+   INPUT:
+   his: B2b correction history
+   nav: navigation data with B2b corrections (updated)
+   obstime: observation time (GPST)
+
+   NOTE:
+   The corrections are set to the latest ones of each satellite not later than
+   the observation time, so the observation time may go forward or backward.
+-----------------------------------------------------------------------------*/
+extern void inputB2bhis(b2bhis_t* his, nav_t* nav, gtime_t obstime)
 {
-    static long last_file_pos = 0; // Static variable to store the position of the last read in the file
-    int Week, Sow, Tod, SSRGap, IODSSR, IODN, SatSlot, SatSlot1, IODCorr, URAclass, URAvalue, sat = -1, i = 0, t1, j = 0, ind = -1;
-    double Rcor, Tcor, Ncor;
-    BOOL isture = 1;
-    gtime_t time = { 0 };
-
-    // Check if the file pointer is valid
-    if (!fp) {
-        perror("Failed to open file B2btype2");
-        exit(EXIT_FAILURE);
+    b2bsat_t* b2bsat = &nav->b2bsat;
+    const b2bhmask_t* mask;
+    b2bhsat_t* hsat;
+    b2bsatp_t* b2bsatp;
+    int i, imask, sat, seq;
+
+    if ((imask = seekB2bline(&his->mask, obstime)) < 0) { // No satellite mask yet
+        if (b2bsat->gen) initB2bsat(b2bsat);
+        return;
     }
-
-    // If there is a saved position from the last read, seek to that position to resume reading from there
-    if (last_file_pos != 0) {
-        if (fseek(fp, last_file_pos, SEEK_SET) != 0) {
-            perror("Failed to seek to last position");
-            exit(EXIT_FAILURE);
-        }
+    mask = (const b2bhmask_t*)dataB2bline(&his->mask, sizeof(b2bhmask_t), imask);
+
+    // The corrections at the start of a generation are kept until the mask changes
+    if (b2bsat->gen != his->mask.gen[imask]) {
+        for (i = 0; i < MAXSAT; i++) b2bsat->b2bpres[i].gen = -1;
+    }
+    b2bsat->gen = his->mask.gen[imask];
+    b2bsat->b2btype1[0] = mask->type1;
+    if (mask->ipre >= 0) {
+        b2bsat->b2btype1[1] = ((const b2bhmask_t*)dataB2bline(&his->mask, sizeof(b2bhmask_t),
+            mask->ipre))->type1;
+    }
+    else initB2btype1(b2bsat->b2btype1 + 1);
+    setB2bmask(mask->mask, b2bsat);
+
+    for (i = 0; i < b2bsat->nsat; i++) {
+        if ((sat = b2bsat->sats[i]) <= 0) continue;
+        hsat = his->sat + sat - 1;
+        b2bsatp = b2bsat->b2bsats + sat - 1;
+
+        setB2bhis(hsat, seekB2bline(&hsat->orb, obstime), seekB2bline(&hsat->dcb, obstime),
+            seekB2bline(&hsat->clk, obstime), b2bsatp);
+        genB2bhis(his, b2bsatp);
+
+        // Corrections at the start of the generation, used until the clock is updated
+        if (b2bsatp->gen != b2bsat->gen ||
+            b2bsatp->b2btype4.Iodp == b2bsat->b2btype1->Iodp ||
+            b2bsat->b2bpres[sat - 1].gen >= 0) continue;
+        seq = mask->gseq;
+        setB2bhis(hsat, prevB2bline(&hsat->orb, hsat->orb.i, seq),
+            prevB2bline(&hsat->dcb, hsat->dcb.i, seq),
+            prevB2bline(&hsat->clk, hsat->clk.i, seq),
+            b2bsat->b2bpres + sat - 1);
+        genB2bhis(his, b2bsat->b2bpres + sat - 1);
     }
-    char line[512];
-
-    // Read the file line by line
-    while (fgets(line, sizeof(line), fp)) {
-        // Record the starting position of the current line at the beginning of each loop
-        long current_line_pos = ftell(fp) - strlen(line);
-
+}
 
-        // Parse the contents of the line
-        if (sscanf(line, "%d %d %d %d %d %d %d %d %d %lf %lf %lf %d %d", &SatSlot1, &Week, &Sow, &Tod, &SSRGap, &IODSSR, &IODN, &SatSlot, &IODCorr, &Rcor, &Tcor, &Ncor, &URAclass, &URAvalue) != 14) {
-            fprintf(stderr, "An error occurred reading the B2btype2 file\n");
-            continue;
-        }
-        // Convert the week and seconds of week into BDT time
-        time = bdt2time(Week, Sow);
+// Free B2b correction history
+extern void freeB2bhis(b2bhis_t* his)
+{
+    int i;
 
-        double ep[6];
-        time2epoch(time, ep);
+    freeB2bline(&his->mask);
+    for (i = 0; i < MAXSAT; i++) {
+        freeB2bline(&his->sat[i].orb);
+        freeB2bline(&his->sat[i].dcb);
+        freeB2bline(&his->sat[i].clk);
+    }
+    his->seq = 0;
+}
 
-        // If the time difference is greater than a tolerance (DTTOL), save the file position and break the loop
-        if (timediff(time, obstime) > DTTOL) 
-        {
-            last_file_pos = current_line_pos; // Save the file position of this line for the next read
-            break;
-        }
-       
-        // Check for valid satellite slot
-        if (SatSlot < 0 || SatSlot>255) {
-            continue;
-        }
-        sat = satSlot2Sat(SatSlot);
-        // Find the index of the satellite in the b2bsat structure
-        for (j = 0; j < b2bsat->nsat; j++) {
-            if (sat != b2bsat->b2bsats[j].sat) continue;
-            ind = j;
-            break;
-        }
-        // If the satellite is not found, skip the current line
-        if (ind == -1) {
-            continue;
-        }
-        // Prepare the data structure for B2bType2
-        B2bType2_t B2bType2;
-        B2bType2.t0 = time;
-        B2bType2.IodSsr = IODSSR;
-        B2bType2.TodBDT = Tod;
-        B2bType2.IODN = IODN;
-        B2bType2.IodCorr = IODCorr;
-        // Validate the IODCorr value
-        if (B2bType2.IodCorr < 0 || B2bType2.IodCorr>7) {
-            isture = 0;
-            continue;
-        }
-        // Radial correction value (Rcor)
-        B2bType2.OrbCorr[0] = Rcor;
-        // Validate the radial correction
-        if (fabs(B2bType2.OrbCorr[0]) - 26.2128 > 1E-6) {
-            isture = 0;
-            continue;
-        }
-        // Tangential correction value (Tcor) C 13 bits
-        B2bType2.OrbCorr[1] = Tcor;
-        // Normal correction value (Ncor) C 13 bits
-        B2bType2.OrbCorr[2] = Ncor;
-        // Validate the tangential and normal corrections
-        for (int j = 1; j < 3; j++) {
-            if (fabs(B2bType2.OrbCorr[j]) - 26.208 > 1E-6) {
-                isture = 0;
-                continue;
-            }
-        }
-        // URA class and value validation
-        B2bType2.UraClass = URAclass;
-        if (B2bType2.UraClass < 0 || B2bType2.UraClass>7) {
-            isture = 0;
-            continue;
-        }
+/* B2b duplicate frame filter --------------------------------------------------
+   The same frame is broadcast by several GEO satellites and a multi-channel
+   receiver logs it once per PRN. A frame carries no PRN, so the copies are
+   identical including the CRC. The frames are kept in a set-associative table
+   keyed on the message type, IODSSR, IODP and TOD, with the CRC to tell the
+   frames of the same key apart (the Type2-4 frames of an epoch). A copy
+   received within B2BDUP_TAGE of the first one is found in the set of the key
+   and the CRC. A full set replaces its oldest frame, so a copy of an evicted
+   frame is decoded again. The update of the corrections then rejects the
+   records older than the current ones of the satellite (see updateB2bsat()).
+-----------------------------------------------------------------------------*/
+extern void initB2bdup(b2bdup_t* dup)
+{
+    memset(dup, 0, sizeof(b2bdup_t));
+}
 
-        B2bType2.UraValue = URAvalue;
-        if (B2bType2.UraValue < 0 || B2bType2.UraValue>7) {
-            isture = 0;
-            continue;
+// Check and register a B2b frame (1: copy of a registered frame, 0: new frame)
+extern int dupB2bmsg(b2bdup_t* dup, const b2bmsg_t* msg)
+{
+    gtime_t time = gpst2time(msg->week, msg->tow);
+    b2bdupent_t* ent, * old = NULL;
+    unsigned int type, key, crc = getbitu(msg->msg, 462, 24);
+    int i, empty = 0;
+
+    // Type (6 bits), TOD (17 bits), IODSSR (2 bits) and IODP of Type1/Type4 (4 bits)
+    type = getbitu(msg->msg, 0, 6);
+    key = (type << 23) | (getbitu(msg->msg, 6, 17) << 6) | (getbitu(msg->msg, 27, 2) << 4);
+    if (type == 1 || type == 4) key |= getbitu(msg->msg, 29, 4);
+
+    ent = dup->ent[((key * 2654435761U) ^ crc) & (B2BDUP_NSET - 1)];
+
+    // Copy of a frame of the set, or the entry to replace (empty, expired or oldest)
+    for (i = 0; i < B2BDUP_NWAY; i++) {
+        if (ent[i].time.time && fabs(timediff(time, ent[i].time)) <= B2BDUP_TAGE) {
+            if (ent[i].key == key && ent[i].crc == crc) return 1;
+            if (!empty && (!old || timediff(ent[i].time, old->time) < 0.0)) old = ent + i;
         }
-        // B2bType2.iB2b = msg->iB2b;// If all values are valid, update the b2bsat structure
-        if (isture) {
-            b2bsat->b2bsats[ind].b2btype2 = B2bType2;
+        else if (!empty) {
+            old = ent + i;
+            empty = 1;
         }
-        // Reset the flags for the next iteration
-        else continue;
-        ind = -1;
-        isture = 1;
     }
-
-
-    fclose(fp);
-
+    old->time = time;
+    old->key = key;
+    old->crc = crc;
+    return 0;
 }
 
-extern void readB2bType3(FILE* fp, b2bsat_t* b2bsat, gtime_t obstime)
+// Decode B2b message log line
+static int decodeB2bline(const char* buff, b2bmsg_t* msg)
 {
-    static long last_file_pos = 0; // Static variable to store the last file read position
-    int SatSlot, Week, Sow, Tod, SSRGap, IODSSR, SatSlot1, CodeNum, sat = -1, i = 0, t1, j = 0, k = 0, ind = -1, slot = 0;
-    double corr[16];
-    int model[16];
-    gtime_t time = { 0 };
+    const char* p;
+    unsigned int b;
+    int i;
 
-    if (!fp) {
-        perror("Failed to open file B2btype3");
-        exit(EXIT_FAILURE);
+    if (sscanf(buff, "%d %d %d", &msg->week, &msg->tow, &msg->prn) < 3 ||
+        !(p = strstr(buff, ": "))) {
+        return 0;
     }
-
-    // If there is a saved file position, start reading from there
-    if (last_file_pos != 0) {
-        if (fseek(fp, last_file_pos, SEEK_SET) != 0) {
-            perror("Failed to seek to last position");
-            exit(EXIT_FAILURE);
-        }
+    memset(msg->msg, 0, sizeof(msg->msg));
+    for (i = 0, p += 2; *p && i < 61 && sscanf(p, "%2X", &b) == 1; p += 2, i++) {
+        msg->msg[i] = (unsigned char)b;
     }
-    char line[512];
-
-    while (fgets(line, sizeof(line), fp)) {
-        // Record the start position of the current line at the beginning of each loop
-        long current_line_pos = ftell(fp) - strlen(line);
-
-        // Parse the file content
-        if (sscanf(line,
-            "%d %d %d %d %d %d %d %d "
-            "%d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf ",
-            &SatSlot, &Week, &Sow, &Tod, &SSRGap, &IODSSR, &SatSlot1, &CodeNum,
-            &model[0], &corr[0], &model[1], &corr[1], &model[2], &corr[2],
-            &model[3], &corr[3], &model[4], &corr[4], &model[5], &corr[5],
-            &model[6], &corr[6], &model[7], &corr[7], &model[8], &corr[8]
-        ) != 24) {
-            fprintf(stderr, "An error occurred reading the B2btype3 file\n");
-            continue;
-        }
-        time = bdt2time(Week, Sow );
+    msg->type = getbitu(msg->msg, 0, 6);
+    return 1;
+}
 
-        double ep[6];
-        time2epoch(time, ep);
+// Read B2b message log file
+static void readB2bmsgs(const char* file, b2b_t* b2b)
+{
+    b2bmsg_t* msgs, msg;
+    char buff[256];
+    FILE* fp;
 
-        // If the time difference between the current data and the observation time exceeds the tolerance (DTTOL),
-        // save the current file position so that the next time we can resume from where we left off.
-        if (timediff(time, obstime) > DTTOL) {
-            last_file_pos = current_line_pos;
-            break;
-        }
-     
-        if (SatSlot == 0) continue;
-        sat = satSlot2Sat(SatSlot);
+    trace(3, "readB2bmsgs: file=%s\n", file);
 
-        for (j = 0; j < b2bsat->nsat; j++) {
-            if (sat != b2bsat->b2bsats[j].sat) continue;
-            ind = j;
-            break;
-        }
-        for (i = 0; i < CodeNum; ++i) {
-            // Update the B2btype3 structure for the corresponding satellite
-            b2bsat->b2bsats[ind].b2btype3.IodSsr = IODSSR;
-            b2bsat->b2bsats[ind].b2btype3.t0 = time;
-            b2bsat->b2bsats[ind].b2btype3.TodBDT = Tod;
+    if (!(fp = fopen(file, "r"))) {
+        trace(2, "B2b message file open error: %s\n", file);
+        return;
+    }
+    while (fgets(buff, sizeof(buff), fp)) {
+        if (!decodeB2bline(buff, &msg)) continue;
 
-            if (ind == -1) {
-                continue;
+        if (b2b->n >= b2b->nmax) {
+            b2b->nmax = b2b->nmax == 0 ? 1024 : b2b->nmax * 2;
+            if (!(msgs = (b2bmsg_t*)realloc(b2b->msgs, b2b->nmax * sizeof(b2bmsg_t)))) {
+                trace(1, "readB2bmsgs malloc error: nmax=%d\n", b2b->nmax);
+                free(b2b->msgs); b2b->msgs = NULL; b2b->n = b2b->nmax = 0;
+                break;
             }
-            b2bsat->b2bsats[ind].b2btype3.SatDCB[model[i]] = corr[i];
+            b2b->msgs = msgs;
         }
-        ind = -1;
+        b2b->msgs[b2b->n++] = msg;
     }
     fclose(fp);
 }
 
-extern void readB2bType4(FILE* fp, b2bsat_t* b2bsat, gtime_t obstime)
+// Compare B2b messages by reception time and PRN
+static int cmpB2bmsgs(const void* p1, const void* p2)
 {
-    static long last_file_pos = 0; // Static variable to store the last file read position
-    int SubType, SubType1, Week, Sow, Week1, Sow1, Tod, SSRGap, IODSSR, IODP, SatNum, sat = -1, i = 0, t1, j = 0, k = 0, ind = -1, slot = 0;
-    double C0[MAXCLOCKCOR];
-    int IODCorr[MAXCLOCKCOR];
-    gtime_t time = { 0 };
-    b2bsat_t* b2bsat_pre;
-    b2bsat_pre = b2bsat;
+    const b2bmsg_t* q1 = (const b2bmsg_t*)p1, * q2 = (const b2bmsg_t*)p2;
 
-    if (!fp) {
-        perror("Failed to open file B2btype4");
-        exit(EXIT_FAILURE);
-    }
+    if (q1->week != q2->week) return q1->week - q2->week;
+    if (q1->tow != q2->tow) return q1->tow - q2->tow;
+    if (q1->prn != q2->prn) return q1->prn - q2->prn;
+    return q1->iB2b - q2->iB2b;
+}
+
+/* read B2b message files -------------------------------------------------------
+   INPUT:
+   file: B2b message log files (wild-card * is expanded, extension .b2b/.B2B)
+   b2b: B2b messages (appended and sorted by reception time)
+
+   OUTPUT:
+   number of B2b messages
+
+   NOTE:
+   One message per line in the form written by outB2bmsg:
+   GPS week, time of week (s), PRN, message type, ":", message (61 bytes hex)
+   The copies of a frame broadcast by other GEO satellites are deleted, so each
+   frame is decoded once.
+-----------------------------------------------------------------------------*/
+extern int readB2bmsg(const char* file, b2b_t* b2b)
+{
+    char* efiles[MAXEXFILE] = { 0 }, * ext;
+    b2bdup_t* dup;
+    int i, j, n;
+
+    trace(3, "readB2bmsg: file=%s\n", file);
 
-    // If there is a saved file position, start reading from there
-    if (last_file_pos != 0) {
-        if (fseek(fp, last_file_pos, SEEK_SET) != 0) {
-            perror("Failed to seek to last position");
-            exit(EXIT_FAILURE);
+    for (i = 0; i < MAXEXFILE; i++) {
+        if (!(efiles[i] = (char*)malloc(1024))) {
+            for (i--; i >= 0; i--) free(efiles[i]);
+            return 0;
         }
     }
-    char line[1024];
+    // Expand wild card in file path
+    n = expath(file, efiles, MAXEXFILE);
 
-    while (fgets(line, sizeof(line), fp)) {
-        // Record the start position of the current line at the beginning of each loop
-        long current_line_pos = ftell(fp) - strlen(line);
-
-
-        // Parse the file content
-        if (sscanf(line,
-            "%d %d %d %d %d %d %d %d %d "
-            "%d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf "
-            "%d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf %d %lf "
-            "%d %lf %d %lf %d %lf "
-            "%d %d",
-            &SubType, &Week, &Sow, &Tod, &SSRGap, &IODSSR, &IODP, &SubType, &SatNum,
-            &IODCorr[0], &C0[0], &IODCorr[1], &C0[1], &IODCorr[2], &C0[2],
-            &IODCorr[3], &C0[3], &IODCorr[4], &C0[4], &IODCorr[5], &C0[5],
-            &IODCorr[6], &C0[6], &IODCorr[7], &C0[7], &IODCorr[8], &C0[8],
-            &IODCorr[9], &C0[9], &IODCorr[10], &C0[10], &IODCorr[11], &C0[11],
-            &IODCorr[12], &C0[12], &IODCorr[13], &C0[13], &IODCorr[14], &C0[14],
-            &IODCorr[15], &C0[15], &IODCorr[16], &C0[16], &IODCorr[17], &C0[17],
-            &IODCorr[18], &C0[18], &IODCorr[19], &C0[19], &IODCorr[20], &C0[20],
-            &IODCorr[21], &C0[21], &IODCorr[22], &C0[22],
-            &Week1, &Sow1) != 57) {
-            fprintf(stderr, "An error occurred reading the B2btype4 file\n");
-            continue;
-        }
-        time = bdt2time(Week, Sow );
+    for (i = 0; i < n; i++) {
+        if (!(ext = strrchr(efiles[i], '.'))) continue;
+        if (strcmp(ext, ".b2b") && strcmp(ext, ".B2B")) continue;
 
-        double ep[6];
-        time2epoch(time, ep);
+        readB2bmsgs(efiles[i], b2b);
+    }
+    for (i = 0; i < MAXEXFILE; i++) free(efiles[i]);
 
-        // If the time difference between the current data and the observation time exceeds the tolerance (DTTOL),
-        // save the current file position so that the next time we can resume from where we left off.
-        if (timediff(time, obstime) > DTTOL) // Save the file position of this line for the next read
-        {
-            last_file_pos = current_line_pos;
-            break;
+    // Sort messages keeping the order of the same reception time and PRN
+    for (i = 0; i < b2b->n; i++) b2b->msgs[i].iB2b = i;
+    if (b2b->n > 0) {
+        qsort(b2b->msgs, b2b->n, sizeof(b2bmsg_t), cmpB2bmsgs);
+    }
+    // Delete copies of frames, the first received one is kept
+    if (b2b->n > 0 && (dup = (b2bdup_t*)malloc(sizeof(b2bdup_t)))) {
+        initB2bdup(dup);
+        for (i = j = 0; i < b2b->n; i++) {
+            if (dupB2bmsg(dup, b2b->msgs + i)) continue;
+            b2b->msgs[j++] = b2b->msgs[i];
         }
-        if (IODSSR < 0 || IODSSR>3) continue;
-        //IODP
-        if (IODP < 0 || IODP>15) continue;
-        //SubType1
-        if (SubType < 0 || SubType>31)continue;
-        j = SubType * MAXCLOCKCOR;
-        // Clock correction values for 23 satellites, followed by reading the next 68 lines to complete the message
-        for (i = 0; i < MAXCLOCKCOR; ++i) {
-            // i + j = 0 to 22: First 23 satellites where the mask is set to 1
-            // i + j = 23 to 45: Next 23 satellites where the mask is set to 1
-            // i + j = 46 to 68: Next 23 satellites where the mask is set to 1
-            // i + j = 69 to 91: Next 23 satellites where the mask is set to 1
-            sat = B2bSubtype2Sat(i + j, b2bsat);
-            for (k = 0; k < b2bsat->nsat; k++) {
-                if (sat != b2bsat->b2bsats[k].sat) continue;
-                ind = k;
-                break;
-            }
-            if (ind == -1) {
-                continue;
-            }
-            // Update the satellite information for the specific satellite index
-            //b2bsat->b2bsats[ind].b2btype4.iB2b = msg->iB2b;
-            b2bsat->b2bsats[ind].b2btype4.Iodp = IODP;
-            b2bsat->b2bsats[ind].b2btype4.TodBDT = Tod;
-            b2bsat->b2bsats[ind].b2btype4.IodSsr = IODSSR;
-            b2bsat->b2bsats[ind].b2btype4.t0 = time;
-            //IOD Corr
-            b2bsat->b2bsats[ind].b2btype4.IodCorr = IODCorr[i];
-            if (b2bsat->b2bsats[ind].b2btype4.IodCorr < 0 || b2bsat->b2bsats[ind].b2btype4.IodCorr>7) {
-                b2bsat = b2bsat_pre;
-                continue;
-            }
-            //C0(15bit)
-            b2bsat->b2bsats[ind].b2btype4.C0 = C0[i];
-            if (fabs(b2bsat->b2bsats[ind].b2btype4.C0) - 27 > 1E-6) {
-                b2bsat = b2bsat_pre;
-                continue;
-            }
-            ind = -1;
+        trace(3, "readB2bmsg: n=%d copies=%d\n", j, b2b->n - j);
+        b2b->n = j;
+        free(dup);
+    }
+    for (i = 0; i < b2b->n; i++) b2b->msgs[i].iB2b = i;
 
-        }
+    return b2b->n;
+}
+
+// Output B2b message in B2b message log format
+extern void outB2bmsg(FILE* fp, const b2bmsg_t* msg)
+{
+    int i;
+
+    trace(4, "outB2bmsg:\n");
+
+    fprintf(fp, "%4d %6d %3d %2d : ", msg->week, msg->tow, msg->prn, msg->type);
+    for (i = 0; i < 61; i++) fprintf(fp, "%02X", msg->msg[i]);
+    fprintf(fp, "\n");
+}
+
+/* input B2b correction stream -------------------------------------------------
+   INPUT:
+   str: B2b correction stream decoder
+   data: stream data (1 byte)
+
+   OUTPUT:
+   status (-1: error, 0: no message, 1: B2b message (str->msg),
+           2: correction record (str->rec))
+
+   NOTE:
+   The stream is line based. A line is either a B2b message in the message log
+   format or a Type1-4 correction record in the text file format, which is told
+   by the number of fields.
+-----------------------------------------------------------------------------*/
+extern int inputB2bstr(b2bstr_t* str, unsigned char data)
+{
+    const char* p;
+    int n;
 
+    if (data != '\n' && data != '\r') {
+        if (str->nbyte < (int)sizeof(str->buff) - 1) str->buff[str->nbyte++] = (char)data;
+        return 0;
     }
-    fclose(fp);
+    if (str->nbyte <= 0) return 0;
+    str->buff[str->nbyte] = '\0';
+    str->nbyte = 0;
 
+    // B2b message
+    if (strstr(str->buff, ": ")) {
+        return decodeB2bline(str->buff, &str->msg) ? 1 : -1;
+    }
+    // Correction record by the number of fields
+    for (p = str->buff, n = 0; *p; n++) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (!*p) break;
+        while (*p && *p != ' ' && *p != '\t') p++;
+    }
+    switch (n) {
+        case 10: n = 1; break;
+        case 14: n = 2; break;
+        case 24: n = 3; break;
+        case 57: n = 4; break;
+        default: n = 0;
+    }
+    return decodeB2brec(str->buff, n, &str->rec) ? 2 : -1;
 }
+
 // Calculate variance from B2b URA value
 extern double varUraB2b(double* ura)
 {
@@ -906,14 +2474,29 @@ extern double varUraB2b(double* ura)
 
 // Compute satellite position and clock bias from CNAV ephemeris
 extern void eph2pos_CNAV(gtime_t time, const eph_t* eph, double* rs, double* dts, double* var)
+{
+    double rsv[6], dtsv[2];
+    int i;
+
+    rsv[0] = rsv[1] = rsv[2] = dtsv[0] = 0.0;
+    eph2posvel_CNAV(time, eph, rsv, dtsv, var);
+    for (i = 0; i < 3; i++) rs[i] = rsv[i];
+    *dts = dtsv[0];
+}
+
+// Compute satellite position/velocity and clock bias/drift from CNAV ephemeris
+// (rs: {x,y,z,vx,vy,vz}, dts: {bias,drift}); velocity and drift are the
+// analytic time derivatives of the propagated orbit and clock
+extern void eph2posvel_CNAV(gtime_t time, const eph_t* eph, double* rs, double* dts, double* var)
 {
     double tk, M, E, Ek, sinE, cosE, u, r, i, O, sin2u, cos2u, x, y, sinO, cosO, cosi, mu, omge;
-    double xg, yg, zg, sino, coso;
-    int n, sys, prn;
-    double Ak, deltna, na, n0;
+    double xg, yg, zg, sino, coso, sini, cosu, sinu, sq1e2;
+    double Ed, ud, rd, id, Od, xd, yd, xgd, ygd, zgd, w, wd;
+    int n, sys, prn, geo;
+    double Ak, deltna, n0;
 
     if (eph->A <= 0.0) {
-        rs[0] = rs[1] = rs[2] = *dts = *var = 0.0;
+        rs[0] = rs[1] = rs[2] = rs[3] = rs[4] = rs[5] = dts[0] = dts[1] = *var = 0.0;
         return;
     }
 
@@ -930,6 +2513,7 @@ extern void eph2pos_CNAV(gtime_t time, const eph_t* eph, double* rs, double* dts
     case SYS_CMP: mu = MU_CMP; omge = OMGE_CMP; break;
     default:      mu = MU_GPS; omge = OMGE;     break;
     }
+    geo = sys == SYS_CMP && (prn <= 5 || prn >= 59);
 
     // Compute mean motion
     n0 = sqrt(mu / (eph->A * eph->A * eph->A));
@@ -945,53 +2529,76 @@ extern void eph2pos_CNAV(gtime_t time, const eph_t* eph, double* rs, double* dts
 
     sinE = sin(E);
     cosE = cos(E);
+    sq1e2 = sqrt(1.0 - eph->e * eph->e);
 
     // Compute satellite position in orbital plane
-    u = atan2(sqrt(1.0 - eph->e * eph->e) * sinE, cosE - eph->e) + eph->omg;
+    u = atan2(sq1e2 * sinE, cosE - eph->e) + eph->omg;
     r = Ak * (1.0 - eph->e * cosE);
     i = eph->i0 + eph->idot * tk;
     sin2u = sin(2.0 * u);
     cos2u = cos(2.0 * u);
 
+    // Rates of eccentric anomaly, argument of latitude, radius and inclination
+    Ed = (n0 + eph->deln + eph->dotn * tk) / (1.0 - eph->e * cosE);
+    ud = sq1e2 * Ed / (1.0 - eph->e * cosE);
+    rd = eph->dotA * (1.0 - eph->e * cosE) + Ak * eph->e * sinE * Ed
+        + 2.0 * ud * (eph->crs * cos2u - eph->crc * sin2u);
+    id = eph->idot + 2.0 * ud * (eph->cis * cos2u - eph->cic * sin2u);
+    ud *= 1.0 + 2.0 * (eph->cus * cos2u - eph->cuc * sin2u);
+
     // Apply harmonic corrections
     u += eph->cus * sin2u + eph->cuc * cos2u;
     r += eph->crs * sin2u + eph->crc * cos2u;
     i += eph->cis * sin2u + eph->cic * cos2u;
 
-    x = r * cos(u);
-    y = r * sin(u);
+    cosu = cos(u);
+    sinu = sin(u);
+    x = r * cosu;
+    y = r * sinu;
+    xd = rd * cosu - y * ud;
+    yd = rd * sinu + x * ud;
     cosi = cos(i);
+    sini = sin(i);
 
-    // Special treatment for BeiDou GEO satellites
-    if (sys == SYS_CMP && prn <= 5) {
-        O = eph->OMG0 + eph->OMGd * tk - omge * eph->toes;
-        sinO = sin(O); cosO = cos(O);
+    // Longitude of ascending node (inertial for BeiDou GEO satellites)
+    Od = geo ? eph->OMGd : eph->OMGd - omge;
+    O = eph->OMG0 + Od * tk - omge * eph->toes;
+    sinO = sin(O); cosO = cos(O);
 
-        xg = x * cosO - y * cosi * sinO;
-        yg = x * sinO + y * cosi * cosO;
-        zg = y * sin(i);
+    xg = x * cosO - y * cosi * sinO;
+    yg = x * sinO + y * cosi * cosO;
+    zg = y * sini;
+    xgd = xd * cosO - yd * cosi * sinO + y * sini * id * sinO - Od * yg;
+    ygd = xd * sinO + yd * cosi * cosO - y * sini * id * cosO + Od * xg;
+    zgd = yd * sini + y * cosi * id;
 
+    // Special treatment for BeiDou GEO satellites
+    if (geo) {
         sino = sin(omge * tk);
         coso = cos(omge * tk);
+        w = yg * COS_5 + zg * SIN_5;
+        wd = ygd * COS_5 + zgd * SIN_5;
 
-        rs[0] = xg * coso + yg * sino * COS_5 + zg * sino * SIN_5;
-        rs[1] = -xg * sino + yg * coso * COS_5 + zg * coso * SIN_5;
+        rs[0] = xg * coso + w * sino;
+        rs[1] = -xg * sino + w * coso;
         rs[2] = -yg * SIN_5 + zg * COS_5;
+        rs[3] = xgd * coso + wd * sino + omge * rs[1];
+        rs[4] = -xgd * sino + wd * coso - omge * rs[0];
+        rs[5] = -ygd * SIN_5 + zgd * COS_5;
     }
     else {
-        O = eph->OMG0 + (eph->OMGd - omge) * tk - omge * eph->toes;
-        sinO = sin(O); cosO = cos(O);
-        rs[0] = x * cosO - y * cosi * sinO;
-        rs[1] = x * sinO + y * cosi * cosO;
-        rs[2] = y * sin(i);
+        rs[0] = xg; rs[1] = yg; rs[2] = zg;
+        rs[3] = xgd; rs[4] = ygd; rs[5] = zgd;
     }
 
-    // Satellite clock bias correction
+    // Satellite clock bias and drift
     tk = timediff(time, eph->toc);
-    *dts = eph->f0 + eph->f1 * tk + eph->f2 * tk * tk;
+    dts[0] = eph->f0 + eph->f1 * tk + eph->f2 * tk * tk;
+    dts[1] = eph->f1 + 2.0 * eph->f2 * tk;
 
     // Apply relativity correction
-    *dts -= 2.0 * sqrt(mu * eph->A) * eph->e * sinE / SQR(CLIGHT);
+    dts[0] -= 2.0 * sqrt(mu * eph->A) * eph->e * sinE / SQR(CLIGHT);
+    dts[1] -= 2.0 * sqrt(mu * eph->A) * eph->e * cosE * Ed / SQR(CLIGHT);
 
     // Estimate position and clock error variance
     *var = var_uraeph(eph->sva);
@@ -1000,27 +2607,31 @@ extern void eph2pos_CNAV(gtime_t time, const eph_t* eph, double* rs, double* dts
 // Select B2b ephemeris data closest to given time
 extern eph_t* selB2beph(gtime_t time, int sat, int iodn, const nav_t* nav)
 {
+    const int* idx;
     double t, tmax, tmin;
-    int i, j = -1;
+    int i, j = -1, k, n;
 
-    // Set maximum allowed time gap depending on satellite system
-    switch (satsys(sat, NULL)) {
-    case SYS_QZS: tmax = MAXDTOE_QZS + 1.0; break;
-    case SYS_GAL: tmax = MAXDTOE_GAL + 1.0; break;
-    case SYS_CMP: tmax = MAXDTOE_CMP + 1.0; break;
-    default:      tmax = MAXDTOE + 1.0; break;
-    }
+    tmax = maxdtoeB2b(sat);
     tmin = tmax + 1.0;
 
+    // Candidates in the toe window of the ephemeris index, or all ephemerides
+    if (!(idx = searcheph(nav, sat, time, tmax, &n))) n = nav->n;
+
     // Search for the best matching ephemeris
-    for (i = 0; i < nav->n; i++) {
+    for (k = 0; k < n; k++) {
+        i = idx ? idx[k] : k;
         if (nav->eph[i].sat != sat) continue;
         if (iodn >= 0 && nav->eph[i].iodc != iodn) continue;
         if ((t = fabs(timediff(nav->eph[i].toe, time))) > tmax) continue;
-        if (iodn >= 0) return nav->eph + i;
-        if (t <= tmin) { j = i; tmin = t; }
+        if (iodn >= 0) {
+            // First match in ephemeris order, as in a linear scan
+            if (j < 0 || i < j) j = i;
+            if (!idx) break;
+            continue;
+        }
+        if (t < tmin || (t == tmin && i > j)) { j = i; tmin = t; }
     }
-    if (iodn >= 0 || j < 0) return NULL;
+    if (j < 0) return NULL;
     return nav->eph + j;
 }
 
@@ -1028,25 +2639,20 @@ extern eph_t* selB2beph(gtime_t time, int sat, int iodn, const nav_t* nav)
 extern int ephpos_B2b(gtime_t time, gtime_t teph, int sat, const nav_t* nav, int iode, double* rs, double* dts, double* var, int* svh)
 {
     eph_t* eph;
-    geph_t* geph;
-    double rst[3], dtst[1], tt = 1E-3;
-    int i, sys;
+    int sys;
 
     sys = satsys(sat, NULL);
     *svh = -1;
 
+    // Position, velocity, clock bias and drift in a single propagation
     if (sys == SYS_CMP) {
         if (!(eph = selB2beph(teph, sat, iode, nav))) return 0;
-        eph2pos_CNAV(time, eph, rs, dts, var);
-        time = timeadd(time, tt);
-        eph2pos_CNAV(time, eph, rst, dtst, var);
+        eph2posvel_CNAV(time, eph, rs, dts, var);
         *svh = eph->svh;
     }
     else if (sys == SYS_GPS || sys == SYS_GAL || sys == SYS_QZS) {
         if (!(eph = selB2beph(teph, sat, iode, nav))) return 0;
-        eph2pos(time, eph, rs, dts, var);
-        time = timeadd(time, tt);
-        eph2pos(time, eph, rst, dtst, var);
+        eph2posvel(time, eph, rs, dts, var);
         *svh = eph->svh;
     }
     else if (sys == SYS_GLO) {
@@ -1054,89 +2660,67 @@ extern int ephpos_B2b(gtime_t time, gtime_t teph, int sat, const nav_t* nav, int
     }
     else return 0;
 
-    // Differentiate position and clock to compute velocity and clock drift
-    for (i = 0; i < 3; i++) rs[i + 3] = (rst[i] - rs[i]) / tt;
-    dts[1] = (dtst[0] - dts[0]) / tt;
-
     return 1;
 }
 
-extern int satpos_B2b(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
-    double* rs, double* dts, double* var, int* svh)
+// B2b corrections of navigation data (the snapshot published by a stream if any)
+static const b2bsat_t* navB2bsat(const nav_t* nav)
+{
+    return nav->b2bp ? nav->b2bp : &nav->b2bsat;
+}
+
+// Select the B2b correction of a satellite valid at the given time
+// (NULL: no correction matching the current or previous mask)
+extern const b2bsatp_t* selB2bcorr(gtime_t time, int sat, const nav_t* nav)
 {
+    const b2bsat_t* b2bsat = navB2bsat(nav);
     const b2bsatp_t* b2bsatp;
-    b2bsat_t b2bsat = nav->b2bsat;
-    eph_t* eph;
-    double t1, t2, t4, er[3], ea[3], ec[3], rc[3], dant[3] = { 0 }, tk;
-    int i, sys, slot, index, num, count = 0, IodCorr4 = -1, ind = -1;
-    int maskSlot[MaskNSAT];
+    int iodp = b2bsat->b2btype1->Iodp, iodssr = b2bsat->b2btype1->IodSsr;
+    double t2, t4;
 
+    if (B2bSatIndex(sat, b2bsat) < 0) return NULL;
 
-    for (i = 0; i < nav->b2bsat.nsat; i++) {
-        b2bsatp = nav->b2bsat.b2bsats + i;
-        if (b2bsatp->sat == sat)break;
-    }
-    if (i >= nav->b2bsat.nsat) {
-        // If the satellite is not found, compute satellite position using broadcast ephemeris
-        ephpos(time, teph, sat, nav, -1, rs, dts, var, svh);
-        *svh = -1;
-        return 0;
-    }
-    if (b2bsatp->b2btype4.Iodp != b2bsatp->b2btype1.Iodp) { // If Iodp doesn't match, use older ephemeris data
+    b2bsatp = b2bsat->b2bsats + sat - 1;
+    if (b2bsatp->gen != b2bsat->gen ||
+        b2bsatp->b2btype4.Iodp != iodp) { // If Iodp doesn't match, use older ephemeris data
 
-        for (i = 0; i < nav->b2bsat_pre.nsat; i++) {
-            b2bsatp = nav->b2bsat_pre.b2bsats + i;
-            if (b2bsatp->sat == sat)break;
-        }
-        if (i >= nav->b2bsat_pre.nsat) {
-            // If the satellite is not found, compute satellite position using broadcast ephemeris
-            ephpos(time, teph, sat, nav, -1, rs, dts, var, svh);
-            *svh = -1;
-            return 0;
-        }
-        if (b2bsatp->b2btype4.Iodp != b2bsatp->b2btype1.Iodp)
-        {
-            ephpos(time, teph, sat, nav, -1, rs, dts, var, svh);
-            *svh = -1;
-            return 0;
-        }
+        if (!(b2bsatp = B2bSatPrevious(sat, b2bsat))) return NULL;
+        iodp = b2bsatp->iodp; // IODP/IODSSR of the mask of the older generation
+        iodssr = b2bsatp->iodssr;
+        if (b2bsatp->b2btype4.Iodp != iodp) return NULL;
     }
-    double OrbCorr[3] = { 0 };
-    OrbCorr[0] = b2bsatp->b2btype2.OrbCorr[0];
-    OrbCorr[1] = b2bsatp->b2btype2.OrbCorr[1];
-    OrbCorr[2] = b2bsatp->b2btype2.OrbCorr[2];
-    double C0 = b2bsatp->b2btype4.C0; // Clock bias correction term
     // IOD (Issue of Data) matching check
-    if (b2bsatp->b2btype1.IodSsr != b2bsatp->b2btype2.IodSsr &&
-        b2bsatp->b2btype1.IodSsr != b2bsatp->b2btype4.IodSsr) {
-        ephpos(time, teph, sat, nav, -1, rs, dts, var, svh);// If not matching, directly calculate satellite position
-        *svh = -1;
-        return 0;
-    }
-    if (b2bsatp->b2btype2.IodCorr != b2bsatp->b2btype4.IodCorr) {
-        ephpos(time, teph, sat, nav, -1, rs, dts, var, svh);// If not matching, directly calculate satellite position
-        *svh = -1;
-        return 0;
-    }
-
+    if (iodssr != b2bsatp->b2btype2.IodSsr &&
+        iodssr != b2bsatp->b2btype4.IodSsr) return NULL;
+    if (b2bsatp->b2btype2.IodCorr != b2bsatp->b2btype4.IodCorr) return NULL;
 
     t2 = timediff(time, b2bsatp->b2btype2.t0);
     t4 = timediff(time, b2bsatp->b2btype4.t0);
 
-    if (fabs(t2) > MAXAGEB2b || fabs(t4) > MAXAGEB2b_CLOCK) {
-        ephpos(time, teph, sat, nav, -1, rs, dts, var, svh); // If the satellite data is too old, directly calculate satellite position
-        *svh = -1;
-        return 0;
-    }
+    // Satellite data too old
+    if (fabs(t2) > MAXAGEB2b || fabs(t4) > MAXAGEB2b_CLOCK) return NULL;
 
-    //* satellite postion and clock by broadcast ephemeris */
-    if (!ephpos_B2b(time, teph, sat, nav, b2bsatp->b2btype2.IODN, rs, dts, var, svh)) return 0; // If matching, compute satellite position
+    return b2bsatp;
+}
 
+// Apply a B2b correction to the satellite position, velocity and clock
+// computed with the broadcast ephemeris matching its IODN
+// (eph: NULL if dts is already the clock by the ephemeris clock parameters)
+extern int corrB2bpos(gtime_t time, int sat, const b2bsatp_t* b2bsatp,
+    const eph_t* eph, double* rs, double* dts, double* var, int* svh)
+{
+    double er[3], ea[3], ec[3], rc[3], tk;
+    double OrbCorr[3] = { 0 }, C0;
+    int i, sys;
+
+    OrbCorr[0] = b2bsatp->b2btype2.OrbCorr[0];
+    OrbCorr[1] = b2bsatp->b2btype2.OrbCorr[1];
+    OrbCorr[2] = b2bsatp->b2btype2.OrbCorr[2];
+    C0 = b2bsatp->b2btype4.C0; // Clock bias correction term
 
     /* satellite clock for gps, galileo and qzss */
     sys = satsys(sat, NULL);
-    if (sys == SYS_GPS || sys == SYS_GAL || sys == SYS_QZS || sys == SYS_CMP) {
-        if (!(eph = selB2beph(teph, sat, b2bsatp->b2btype2.IODN, nav))) return 0;
+    if (eph && (sys == SYS_GPS || sys == SYS_GAL || sys == SYS_QZS || sys == SYS_CMP)) {
 
         /* satellite clock by clock parameters */
         tk = timediff(time, eph->toc);
@@ -1155,8 +2739,7 @@ extern int satpos_B2b(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
     }
     cross3(ea, ec, er); // Calculate radial, cross, and along-track unit vectors for corrections
 
-    /* Satellite antenna offset correction */
-    satantoff(time, rs, sat, nav, dant);
+    // B2b orbit corrections refer to the antenna phase center, no offset is applied
 
     for (i = 0; i < 3; i++) {
         rs[i] += -(er[i] * OrbCorr[0] + ea[i] * OrbCorr[1] + ec[i] * OrbCorr[2]); // Apply satellite position corrections
@@ -1172,15 +2755,168 @@ extern int satpos_B2b(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
     *var = varUraB2b(Ura); // Calculate the variance using B2b URA class and value
     return 1;
 }
+
+/* initialize B2b orbit cache -------------------------------------------------
+* initialize the orbit cache shared by processing sessions
+* args   : b2bcache_t* cache IO cache
+* return : none
+* notes  : set nav->b2bsat.cache of each session to the cache to use it.
+*          satpos_B2b() evaluates a broadcast satellite orbit by cubic Hermite
+*          interpolation between nodes at B2BCACHE_TINT-aligned times, which
+*          are computed once per satellite and broadcast ephemeris identified
+*          by IODN and toe, and applies the broadcast clock and B2b
+*          corrections as without the cache. the interpolation error is below
+*          1e-6 m at the interval ends and 1e-4 m within the interval.
+*          the cache is thread-safe by satellite locks. initialize it once
+*          and keep it over sessions and generations of B2b corrections.
+*-----------------------------------------------------------------------------*/
+extern void initB2bcache(b2bcache_t* cache)
+{
+    gtime_t time0 = { 0 };
+    int i, j;
+
+    for (i = 0; i < MAXSAT; i++) {
+        for (j = 0; j < B2BCACHE_NENT; j++) cache->ent[i][j].ta = time0;
+        cache->next[i] = 0;
+        initlock(cache->lock + i);
+    }
+}
+
+// Compute the broadcast orbit at the ends of a cache interval
+static void nodeB2bcent(gtime_t ta, int sat, const eph_t* eph, b2bcent_t* ent)
+{
+    double dts[2], var;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (satsys(sat, NULL) == SYS_CMP) {
+            eph2posvel_CNAV(timeadd(ta, i * B2BCACHE_TINT), eph, ent->rs[i], dts, &var);
+        }
+        else eph2posvel(timeadd(ta, i * B2BCACHE_TINT), eph, ent->rs[i], dts, &var);
+    }
+    ent->ta = ta;
+    ent->toe = eph->toe;
+    ent->toc = eph->toc;
+    ent->iodn = eph->iodc;
+    ent->svh = eph->svh;
+    ent->f[0] = eph->f0; ent->f[1] = eph->f1; ent->f[2] = eph->f2;
+}
+
+// B2b corrected satellite position, velocity and clock by the shared orbit cache
+static int cacheB2bpos(b2bcache_t* cache, gtime_t time, gtime_t teph, int sat,
+    const nav_t* nav, const b2bsatp_t* b2bsatp, double* rs, double* dts, double* var,
+    int* svh)
+{
+    const b2bcent_t* p;
+    b2bcent_t ent;
+    eph_t* eph;
+    gtime_t ta = { 0 };
+    double s, T = B2BCACHE_TINT, h[4], d[4], tk;
+    int i, j, iodn = b2bsatp->b2btype2.IODN, sys = satsys(sat, NULL);
+
+    if (sys != SYS_GPS && sys != SYS_GAL && sys != SYS_QZS && sys != SYS_CMP) return 0;
+
+    // An IODN may be reused by another ephemeris, which differs in toe
+    if (!(eph = selB2beph(teph, sat, iodn, nav))) return 0;
+
+    // Node interval including the time
+    ta.time = time.time - (time.time % B2BCACHE_TINT + B2BCACHE_TINT) % B2BCACHE_TINT;
+
+    lock(cache->lock + sat - 1);
+    for (i = 0; i < B2BCACHE_NENT; i++) {
+        p = cache->ent[sat - 1] + i;
+        if (p->ta.time == ta.time && p->iodn == iodn &&
+            timediff(p->toe, eph->toe) == 0.0) break;
+    }
+    if (i < B2BCACHE_NENT) ent = *p;
+    unlock(cache->lock + sat - 1);
+
+    if (i >= B2BCACHE_NENT) {
+        nodeB2bcent(ta, sat, eph, &ent);
+
+        lock(cache->lock + sat - 1);
+        cache->ent[sat - 1][cache->next[sat - 1]] = ent;
+        cache->next[sat - 1] = (cache->next[sat - 1] + 1) % B2BCACHE_NENT;
+        unlock(cache->lock + sat - 1);
+    }
+    // Cubic Hermite interpolation of position and velocity
+    s = timediff(time, ta) / T;
+    h[0] = (2.0 * s - 3.0) * s * s + 1.0; d[0] = (6.0 * s - 6.0) * s / T;
+    h[1] = ((s - 2.0) * s + 1.0) * s * T; d[1] = (3.0 * s - 4.0) * s + 1.0;
+    h[2] = (3.0 - 2.0 * s) * s * s;       d[2] = (6.0 - 6.0 * s) * s / T;
+    h[3] = (s - 1.0) * s * s * T;         d[3] = (3.0 * s - 2.0) * s;
+
+    for (j = 0; j < 3; j++) {
+        rs[j] = h[0] * ent.rs[0][j] + h[1] * ent.rs[0][j + 3] +
+            h[2] * ent.rs[1][j] + h[3] * ent.rs[1][j + 3];
+        rs[j + 3] = d[0] * ent.rs[0][j] + d[1] * ent.rs[0][j + 3] +
+            d[2] * ent.rs[1][j] + d[3] * ent.rs[1][j + 3];
+    }
+    // Satellite clock by clock parameters with relativity correction
+    tk = timediff(time, ent.toc);
+    dts[0] = ent.f[0] + ent.f[1] * tk + ent.f[2] * tk * tk;
+    dts[1] = ent.f[1] + 2.0 * ent.f[2] * tk;
+    dts[0] -= 2.0 * dot(rs, rs + 3, 3) / CLIGHT / CLIGHT;
+
+    *svh = ent.svh;
+    return corrB2bpos(time, sat, b2bsatp, NULL, rs, dts, var, svh);
+}
+
+extern int satpos_B2b(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
+    double* rs, double* dts, double* var, int* svh)
+{
+    const b2bsatp_t* b2bsatp;
+    eph_t* eph = NULL;
+    int sys;
+
+    if (!(b2bsatp = selB2bcorr(time, sat, nav))) {
+        // If no valid correction, compute satellite position using broadcast ephemeris
+        ephpos(time, teph, sat, nav, -1, rs, dts, var, svh);
+        *svh = -1;
+        return 0;
+    }
+    // Broadcast orbit by the shared orbit cache
+    if (nav->b2bsat.cache &&
+        cacheB2bpos(nav->b2bsat.cache, time, teph, sat, nav, b2bsatp, rs, dts, var, svh)) {
+        return 1;
+    }
+    //* satellite postion and clock by broadcast ephemeris */
+    if (!ephpos_B2b(time, teph, sat, nav, b2bsatp->b2btype2.IODN, rs, dts, var, svh)) return 0; // If matching, compute satellite position
+
+    sys = satsys(sat, NULL);
+    if (sys == SYS_GPS || sys == SYS_GAL || sys == SYS_QZS || sys == SYS_CMP) {
+        if (!(eph = selB2beph(teph, sat, b2bsatp->b2btype2.IODN, nav))) return 0;
+    }
+    return corrB2bpos(time, sat, b2bsatp, eph, rs, dts, var, svh);
+}
+// Get B2b Type3 DCB of an obs code by the signal mode table (0: no DCB of the code)
+extern int B2bcodeDCB(const nav_t* nav, int sat, uint8_t code, double* dcb)
+{
+    const b2bsat_t* b2bsat;
+    const b2bsatp_t* b2bsatp;
+    int sys, mode;
+
+    if (sat <= 0 || sat > MAXSAT || code > MAXCODE) return 0;
+    sys = nav->meta ? nav->meta[sat - 1].sys : satsys(sat, NULL);
+    if (sys != SYS_CMP && sys != SYS_GPS) return 0;
+
+    b2bsat = navB2bsat(nav);
+    if ((mode = b2bsat->dcbmode[sys == SYS_CMP ? 0 : 1][code]) < 0) return 0;
+
+    b2bsatp = b2bsat->b2bsats + sat - 1;
+    *dcb = b2bsatp->b2btype3.SatDCB[mode];
+    return 1;
+}
 extern double prange_dualfrequency(const obsd_t* obs, const nav_t* nav, double* var
     , const double* dantr, const double* dants, const prcopt_t* opt)
 {
-    double gamma, tgd1 = 0.0, tgd2 = 0.0, tgd = 0, t = 0, dcb1 = 0, dcb2 = 0, dcb = 0;
-    double freq[NFREQ] = { 0 };
+    double gamma, t = 0, dcb1 = 0, dcb2 = 0, dcb = 0;
+    double freq[2] = { 0 };
     int i;
+    const b2bsat_t* b2bsat = navB2bsat(nav);
     const b2bsatp_t* b2bsatp;
-    // Calculate the frequencies for each signal from the observation data
-    for (i = 0; i < NFREQ; i++)
+    // Calculate the frequencies of the signals of the combination
+    for (i = 0; i < 2; i++)
     {
         freq[i] = sat2freq(obs->sat, obs->code[i], nav);
     }
@@ -1194,74 +2930,37 @@ extern double prange_dualfrequency(const obsd_t* obs, const nav_t* nav, double*
     int sat = obs->sat, sys;
 
     // Find the satellite in the broadcast satellite data (b2bsat)
-    for (i = 0; i < nav->b2bsat.nsat; i++) {
-        b2bsatp = nav->b2bsat.b2bsats + i;
-        if (b2bsatp->sat == sat)break;
-    }
     // If the satellite is not found, calculate the ionospheric-free pseudo-range without 
     // any correction from DCB (Differential Code Bias).
-    if (i >= nav->b2bsat.nsat) {
+    if (B2bSatIndex(sat, b2bsat) < 0) {
         return  ((P2 - gamma * P1) - (dcb2 - gamma * dcb1)) / (1.0 - gamma);
     }
+    b2bsatp = b2bsat->b2bsats + sat - 1;
     // Calculate the time difference between the observation time and the satellite time
     t = timediff(obs->time, b2bsatp->b2btype3.t0);
     // If the time difference is too large, use the simplified calculation for the ionospheric-free range
     if (fabs(t) > MAXAGEB2b_CBIAS) return  ((P2 - gamma * P1) - (dcb2 - gamma * dcb1)) / (1.0 - gamma);
     // Determine the satellite system type
-    if (!(sys = satsys(sat, NULL))) return 0.0;
+    if (!(sys = nav->meta ? nav->meta[sat - 1].sys : satsys(sat, NULL))) return 0.0;
     *var = 0;
     // Check if the dual-frequency data is valid (i.e., non-zero values for both frequencies)
     if (P1 == 0 || P2 == 0)return 0.0; // Incomplete dual-frequency data, cannot process
-    if (P1 == 0 || P2 == 0)return 0.0; // Incomplete dual-frequency data, cannot process
     // Check if the satellites ionospheric correction (IodSsr) is valid
     if (b2bsatp->b2btype3.IodSsr != b2bsatp->b2btype2.IodSsr &&
         b2bsatp->b2btype3.IodSsr != b2bsatp->b2btype4.IodSsr &&
-        b2bsatp->b2btype3.IodSsr != b2bsatp->b2btype1.IodSsr)return  ((P2 - gamma * P1) - (dcb2 - gamma * dcb1)) / (1.0 - gamma);
-
-    // Specific handling for GPS system to account for differential code bias (DCB)
-    if (sys == SYS_GPS) {
-        // Loop through each code and apply corresponding DCB values
-        for (int i = 0; i < 2; i++) {
-            if (obs->code[i] == CODE_L1C) dcb = b2bsatp->b2btype3.SatDCB[0];//L1C/A
-            if (obs->code[i] == CODE_L1P) dcb = b2bsatp->b2btype3.SatDCB[1];//L1P
-            if (obs->code[i] == CODE_L1L) dcb = b2bsatp->b2btype3.SatDCB[4];//L1C(P)
-            if (obs->code[i] == CODE_L1X) dcb = b2bsatp->b2btype3.SatDCB[5];//L1C(D+P)
-            if (obs->code[i] == CODE_L2L) dcb = b2bsatp->b2btype3.SatDCB[7];//L2C(L)
-            if (obs->code[i] == CODE_L2X) dcb = b2bsatp->b2btype3.SatDCB[8];//L2C(M+L)
-            if (obs->code[i] == CODE_L5I) dcb = b2bsatp->b2btype3.SatDCB[11];//L5I
-            if (obs->code[i] == CODE_L5Q) dcb = b2bsatp->b2btype3.SatDCB[12];//L5Q
-            if (obs->code[i] == CODE_L5X) dcb = b2bsatp->b2btype3.SatDCB[12];//L5 I+Q
-            // Store DCB values for both frequencies
-            if (i == 0)  dcb1 = dcb;
-            else dcb2 = dcb;
-        }
-        // Return the ionospheric-free pseudo-range corrected for DCB
-        return ((P2 - gamma * P1) - (dcb2 - gamma * dcb1)) / (1.0 - gamma);
-    }
-    else if (sys == SYS_QZS) {
-    }
-    else if (sys == SYS_GLO) { /* G1-G2 */
-        return (P2 - gamma * P1) / (1.0 - gamma);
-    }
-    // Specific handling for BeiDou (COMPASS) system
-    else if (sys == SYS_CMP) {
-        // Loop through each code and apply corresponding DCB values for BeiDou
-        for (int i = 0; i < 2; i++) {
-            if (obs->code[i] == CODE_L2I) dcb = b2bsatp->b2btype3.SatDCB[0];//B1I
-            if (obs->code[i] == CODE_L1D) dcb = b2bsatp->b2btype3.SatDCB[1];//B1C(D)
-            if (obs->code[i] == CODE_L1P) dcb = b2bsatp->b2btype3.SatDCB[2];//B1C(P)
-            if (obs->code[i] == CODE_L5D) dcb = b2bsatp->b2btype3.SatDCB[4];//B2a(D)
-            if (obs->code[i] == CODE_L5P) dcb = b2bsatp->b2btype3.SatDCB[5];//B2a(P)
-            if (obs->code[i] == CODE_L7I) dcb = b2bsatp->b2btype3.SatDCB[7];//B2b-I
-            if (obs->code[i] == CODE_L7Q) dcb = b2bsatp->b2btype3.SatDCB[8];//B2b-Q
-            if (obs->code[i] == CODE_L6I) dcb = b2bsatp->b2btype3.SatDCB[12];//B3I
-            // Store DCB values for both frequencies
-            if (i == 0)  dcb1 = dcb;
+        b2bsatp->b2btype3.IodSsr != b2bsat->b2btype1->IodSsr)return  ((P2 - gamma * P1) - (dcb2 - gamma * dcb1)) / (1.0 - gamma);
+
+    // DCB of the codes by the Type3 signal mode table, the DCB of the first code
+    // is applied to the second code without signal mode
+    if (sys == SYS_GPS || sys == SYS_CMP) {
+        for (i = 0; i < 2; i++) {
+            B2bcodeDCB(nav, sat, obs->code[i], &dcb);
+            if (i == 0) dcb1 = dcb;
             else dcb2 = dcb;
         }
-        // Return the ionospheric-free pseudo-range corrected for DCB
-        return ((P2 - gamma * P1) - (dcb2 - gamma * dcb1)) / (1.0 - gamma);
     }
+    // Return the ionospheric-free pseudo-range corrected for DCB
+    return ((P2 - gamma * P1) - (dcb2 - gamma * dcb1)) / (1.0 - gamma);
 }
 
 
@@ -5,23 +5,54 @@
 extern int satSlot2Sat(int SatSlot);
 extern int sat2Slot(int sat);
 extern int add_eph(nav_t* nav, const eph_t* eph);
-extern initB2b(nav_t* navs);
-extern void readB2bType1(FILE* fp, b2bsat_t* b2bsat, b2bsat_t* b2bsat_pre, gtime_t obstime);
-extern void readB2bType2(FILE* fp, b2bsat_t* b2bsat, gtime_t obstime);
-extern void readB2bType3(FILE* fp, b2bsat_t* b2bsat, gtime_t obstime);
-extern void readB2bType4(FILE* fp, b2bsat_t* b2bsat, gtime_t obstime);
+extern int initB2b(nav_t* navs);
+extern void initB2bsat(b2bsat_t* b2bsat);
+extern int decodeB2brec(const char* line, int type, b2brec_t* rec);
+extern void readB2bType1(b2bcur_t* cur, nav_t* nav, gtime_t obstime);
+extern void readB2bType2(b2bcur_t* cur, nav_t* nav, gtime_t obstime);
+extern void readB2bType3(b2bcur_t* cur, nav_t* nav, gtime_t obstime);
+extern void readB2bType4(b2bcur_t* cur, nav_t* nav, gtime_t obstime);
+extern int updateB2bsat(const b2brec_t* rec, b2bsat_t* b2bsat);
+extern int updateB2brec(const b2brec_t* rec, nav_t* nav);
+extern int openB2breader(b2b_reader_t* reader, char** files, gtime_t ts);
+extern void closeB2breader(b2b_reader_t* reader);
+extern void inputB2breader(b2b_reader_t* reader, nav_t* nav, gtime_t obstime);
+extern int convB2bbin(char** files, const char* outfile);
+extern int openB2bbin(b2b_reader_t* reader, const char* file, gtime_t ts);
+extern int decodeB2bsat(const b2bmsg_t* msg, b2bsat_t* b2bsat);
+extern int decodeB2bmsg(const b2bmsg_t* msg, nav_t* nav);
+extern int inputB2bmsg(const b2b_t* b2b, int* index, nav_t* nav, gtime_t obstime);
+extern int buildB2bhis(b2bhis_t* his, b2b_reader_t* reader, const b2b_t* b2b);
+extern void inputB2bhis(b2bhis_t* his, nav_t* nav, gtime_t obstime);
+extern void freeB2bhis(b2bhis_t* his);
+extern int readB2bmsg(const char* file, b2b_t* b2b);
+extern void initB2bdup(b2bdup_t* dup);
+extern int dupB2bmsg(b2bdup_t* dup, const b2bmsg_t* msg);
+extern void outB2bmsg(FILE* fp, const b2bmsg_t* msg);
+extern int inputB2bstr(b2bstr_t* str, unsigned char data);
 extern int readRinex4Nav(const char* file, nav_t* nav);
+extern int readRinex4Navt(const char* file, gtime_t ts, gtime_t te, nav_t* nav);
+extern int openRinex4Nav(rnx4nav_t* rnav, char** files, int n, gtime_t ts, nav_t* nav);
+extern int slideRinex4Nav(rnx4nav_t* rnav, nav_t* nav, gtime_t time);
+extern void closeRinex4Nav(rnx4nav_t* rnav);
 extern int satpos_B2b(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
     double* rs, double* dts, double* var, int* svh);
+extern const b2bsatp_t* selB2bcorr(gtime_t time, int sat, const nav_t* nav);
+extern void initB2bcache(b2bcache_t* cache);
+extern int corrB2bpos(gtime_t time, int sat, const b2bsatp_t* b2bsatp,
+    const eph_t* eph, double* rs, double* dts, double* var, int* svh);
 extern int ephpos_B2b(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
     int iode, double* rs, double* dts, double* var, int* svh);
 extern eph_t* selB2beph(gtime_t time, int sat, int iodn, const nav_t* nav);
 extern void eph2pos_CNAV(gtime_t time, const eph_t* eph, double* rs, double* dts,
     double* var);
+extern void eph2posvel_CNAV(gtime_t time, const eph_t* eph, double* rs, double* dts,
+    double* var);
 extern double varUraB2b(double* ura);
 extern int ephpos(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
     int iode, double* rs, double* dts, double* var, int* svh);
 extern double var_uraeph(int ura);
+extern int B2bcodeDCB(const nav_t* nav, int sat, uint8_t code, double* dcb);
 extern double prange_dualfrequency(const obsd_t* obs, const nav_t* nav, double* var,
     const double* dantr, const double* dants, const prcopt_t* opt);
 
@@ -13,6 +13,26 @@
 // Incremental parameters for B2b message types
 #define MAXORBITCOR 6+1  // Max orbit corrections per Type2 message (+1 to prevent overflow)
 #define MAXCLOCKCOR 23   // Max clock corrections per Type4 message
+#define MAXCODECOR 31    // Max satellites of code biases per Type3 message
+
+// B2b binary correction container
+#define B2BBIN_MAGIC "B2BBIN"   // Container file identifier
+#define B2BBIN_VER 2            // Container format version
+#define B2BBIN_NIDX 64          // Records per time index entry
+
+// B2b text correction file index
+#define B2BIDX_MAGIC "B2BIDX"   // Index file identifier
+#define B2BIDX_VER 3            // Index format version
+#define B2BIDX_TINT 300         // Time interval of index entries (s)
+
+// Shared orbit cache
+#define B2BCACHE_TINT 30        // Time interval of cache nodes (s)
+#define B2BCACHE_NENT 4         // Number of cache entries per satellite
+
+// B2b duplicate frame filter
+#define B2BDUP_NSET 256         // Number of filter sets (power of 2)
+#define B2BDUP_NWAY 4           // Number of filter entries per set
+#define B2BDUP_TAGE 60.0        // Max reception time difference of copies (s)
 
 // Validity periods for B2b corrections
 #define MAXAGEB2b 96.0          // Max age of B2b orbit/URA corrections (seconds)
@@ -84,16 +104,178 @@ typedef struct {        /* B2b Type4 - Clock correction */
 
 typedef struct {        /* B2b correction for current epoch */
     int sat;            /* Satellite index */
-    B2bType1_t b2btype1;/* Type1 correction data */
+    int gen;            /* Generation of corrections (-1: none) */
+    int iodp, iodssr;   /* IODP/IODSSR of the mask of the generation (-1: none) */
     B2bType2_t b2btype2;/* Type2 correction data */
     B2bType3_t b2btype3;/* Type3 correction data */
     B2bType4_t b2btype4;/* Type4 correction data */
 } b2bsatp_t;
 
+typedef struct {        /* B2b orbit cache entry */
+    gtime_t ta;         /* start time of node interval (0: empty) */
+    gtime_t toe;        /* toe of broadcast ephemeris */
+    gtime_t toc;        /* toc of broadcast ephemeris */
+    int iodn;           /* IODN (iodc) of broadcast ephemeris */
+    int svh;            /* satellite health of broadcast ephemeris */
+    double f[3];        /* clock parameters {f0,f1,f2} of broadcast ephemeris */
+    double rs[2][6];    /* position/velocity at interval ends (m|m/s) */
+} b2bcent_t;
+
+typedef struct {        /* B2b orbit cache shared by sessions */
+    b2bcent_t ent[MAXSAT][B2BCACHE_NENT]; /* cache entries by satellite */
+    int next[MAXSAT];   /* next entry to replace by satellite */
+    lock_t lock[MAXSAT]; /* lock flags by satellite */
+} b2bcache_t;
+
 typedef struct {        /* B2b satellite corrections container */
     int nsat;           /* Number of satellites */
-    int SatSlot[MaskNSAT]; /* Satellite slot numbers:
+    unsigned char SatSlot[MaskNSAT]; /* Satellite mask flags by slot:
                             0-62: BDS; 63-99: GPS;
                             100-136: Galileo; 137-173: GLONASS */
-    b2bsatp_t b2bsats[MAXSAT]; /* Array of satellite corrections */
+    int gen;            /* Generation of corrections (incremented on IODP change) */
+    B2bType1_t b2btype1[2]; /* Type1 data of current/previous generation */
+    int sats[MaskNSAT]; /* Satellites in mask order (0: not supported) */
+    int index[MAXSAT];  /* Mask order of satellites (-1: not in mask) */
+    b2bsatp_t b2bsats[MAXSAT]; /* Satellite corrections by satellite */
+    b2bsatp_t b2bpres[MAXSAT]; /* Satellite corrections of previous generation
+                                  saved on the first update in a generation */
+    b2bcache_t* cache;  /* Shared orbit cache (NULL: not used) */
+    signed char dcbmode[2][MAXCODE + 1]; /* Type3 signal mode by obs code
+                                            (0: BDS, 1: GPS) (-1: no DCB) */
 } b2bsat_t;
+
+typedef struct {        /* B2b correction record type */
+    gtime_t time;       /* reference time (GPST) */
+    int type;           /* message type (1-4) */
+    int tod;            /* BDT time of day (TOD) */
+    int iodssr;         /* SSR Issue of Data */
+    int iodp;           /* Issue of Data for phase (Type1/Type4) */
+    int slot;           /* satellite slot (Type2/Type3) or subtype (Type4) */
+    int iodn;           /* Issue of Data for navigation (Type2) */
+    int n;              /* number of code biases (Type3) or satellites (Type4) */
+    int ura[2];         /* URA class/value (Type2) */
+    int mode[NMODESINGAL]; /* signal tracking modes (Type3) */
+    int iodcorr[MAXCLOCKCOR]; /* Issue of Data for correction (Type2/Type4) */
+    double val[MAXCLOCKCOR]; /* orbit corrections (Type2), code biases (Type3)
+                            or clock corrections (Type4) (m) */
+    unsigned char mask[MaskNSAT]; /* satellite mask (Type1) */
+} b2brec_t;
+
+typedef struct {        /* B2b binary correction record type (92 bytes) */
+    int t;              /* reference time (BDT seconds from BDT week 0) */
+    int ta;             /* apply time (max reference time up to the record) */
+    int tod;            /* BDT time of day (TOD) */
+    unsigned char type; /* message type (1-4) */
+    unsigned char iodssr; /* SSR Issue of Data */
+    unsigned char iodp; /* Issue of Data for phase (Type1/Type4) */
+    unsigned char n;    /* number of code biases (Type3) or satellites (Type4) */
+    short slot;         /* satellite slot (Type2/Type3) or subtype (Type4) */
+    short iodn;         /* Issue of Data for navigation (Type2) */
+    unsigned char ura[2]; /* URA class/value (Type2) */
+    unsigned char iod[MAXCLOCKCOR]; /* IODCorr (Type2/Type4) or signal modes (Type3) */
+    unsigned char pad;  /* padding */
+    short val[MAXCLOCKCOR]; /* corrections in ICD LSB units (Type2-4) or
+                            satellite mask bits (Type1) */
+} b2bbin_t;
+
+typedef struct {        /* B2b binary container section type */
+    int type;           /* message type (1-4) */
+    int n;              /* number of records */
+    int off;            /* offset of records from file head (bytes) */
+    int ni;             /* number of time index entries */
+    int ioff;           /* offset of time index from file head (bytes) */
+    int ts, te;         /* first/last record apply time (BDT seconds) */
+} b2bbinsec_t;
+
+typedef struct {        /* B2b binary container header type */
+    char magic[8];      /* file identifier (B2BBIN_MAGIC) */
+    int ver;            /* format version (B2BBIN_VER) */
+    int nidx;           /* records per time index entry */
+    int size;           /* record size (bytes) */
+    b2bbinsec_t sec[4]; /* Type1-4 sections */
+} b2bbinhdr_t;
+
+typedef struct {        /* B2b text file index header type */
+    char magic[8];      /* file identifier (B2BIDX_MAGIC) */
+    int ver;            /* format version (B2BIDX_VER) */
+    int tint;           /* time interval of index entries (s) */
+    int n;              /* number of index entries */
+    long long size;     /* size of indexed file (bytes) */
+    double mtime;       /* modification time of indexed file (time_t) */
+} b2bidxhdr_t;
+
+typedef struct {        /* B2b text file index entry type */
+    int ta;             /* apply time of the first record of interval (BDT seconds) */
+    long long off;      /* offset of the record from file head (bytes) */
+} b2bidx_t;
+
+typedef struct {        /* B2b correction file cursor type */
+    FILE* fp;           /* file pointer (NULL: not opened) */
+    int pend;           /* look-ahead record pending flag */
+    b2brec_t rec;       /* look-ahead record */
+    const b2bbin_t* p;  /* next binary record (NULL: text file) */
+    const b2bbin_t* pe; /* end of binary records */
+} b2bcur_t;
+
+typedef struct {        /* B2b correction reader type */
+    b2bcur_t cur[4];    /* Type1-4 file cursors */
+    void* map;          /* mapped binary container (NULL: none) */
+    size_t size;        /* size of mapped container (bytes) */
+} b2b_reader_t;
+
+typedef struct {        /* RINEX 4 navigation file type */
+    char path[MAXSTRPATH]; /* file path */
+    gtime_t ts, te;     /* toe range of ephemerides in file */
+} rnx4navf_t;
+
+typedef struct {        /* RINEX 4 navigation sliding window type */
+    int n;              /* number of files */
+    rnx4navf_t* file;   /* navigation files */
+    gtime_t tw;         /* end of loaded window */
+} rnx4nav_t;
+
+typedef struct {        /* B2b duplicate frame filter entry type */
+    gtime_t time;       /* reception time of frame (0: empty) */
+    unsigned int key;   /* message type, IODSSR, IODP and TOD of frame */
+    unsigned int crc;   /* CRC-24 of frame */
+} b2bdupent_t;
+
+typedef struct {        /* B2b duplicate frame filter type */
+    b2bdupent_t ent[B2BDUP_NSET][B2BDUP_NWAY]; /* entries by set */
+} b2bdup_t;
+
+typedef struct {        /* B2b correction stream decoder type */
+    int nbyte;          /* number of bytes in line buffer */
+    char buff[1024];    /* line buffer */
+    b2bmsg_t msg;       /* decoded B2b message */
+    b2brec_t rec;       /* decoded B2b correction record */
+} b2bstr_t;
+
+typedef struct {        /* B2b correction timeline type */
+    int n, nmax;        /* number of updates / max allocated */
+    int i;              /* index of update at the last input (-1: none) */
+    gtime_t* time;      /* apply times of updates (GPST) */
+    int* seq;           /* sequence numbers of updates */
+    int* gen;           /* generations of corrections */
+    void* data;         /* correction data of updates */
+} b2bline_t;
+
+typedef struct {        /* B2b satellite mask of history type */
+    int gseq;           /* sequence number of the first mask of the generation */
+    int ipre;           /* index of the last mask of the previous generation (-1: none) */
+    B2bType1_t type1;   /* Type1 data */
+    unsigned char mask[MaskNSAT]; /* satellite mask */
+} b2bhmask_t;
+
+typedef struct {        /* B2b correction history of a satellite type */
+    b2bline_t orb;      /* orbit corrections (B2bType2_t) */
+    b2bline_t dcb;      /* code biases (B2bType3_t) */
+    b2bline_t clk;      /* clock corrections (B2bType4_t) */
+} b2bhsat_t;
+
+typedef struct {        /* B2b correction history type */
+    b2bline_t mask;     /* satellite masks (b2bhmask_t) */
+    b2bhsat_t sat[MAXSAT]; /* corrections of satellites */
+    int seq;            /* sequence number of the last update */
+    b2bsat_t b2bsat;    /* corrections of the last update */
+} b2bhis_t;
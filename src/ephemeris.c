@@ -74,6 +74,10 @@ en precise clock outage
 *-----------------------------------------------------------------------------*/
 #include "rtklib.h"
 #include "B2bLIB.h"//GCC
+#if !defined(NOSIMD)&&defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#define ENASIMD                   /* simd kernel of eph2posvels() */
+#include <immintrin.h>
+#endif
 
 /* constants and macros ------------------------------------------------------*/
 
@@ -106,6 +110,8 @@ en precise clock outage
 #define STD_GAL_NAPA 500.0        /* error of galileo ephemeris for NAPA (m) */
 
 #define MAX_ITER_KEPLER 30        /* max number of iteration of Kelpler */
+#define NBATCH   32               /* max number of ephemerides in batch */
+#define NITER_KEPLER 6            /* iterations of Kepler in batch simd kernel */
 
 /* ephemeris selections ------------------------------------------------------*/
 static int eph_sel[]={ /* GPS,GLO,GAL,QZS,BDS,IRN,SBS */
@@ -212,13 +218,38 @@ extern double eph2clk(gtime_t time, const eph_t *eph)
 *-----------------------------------------------------------------------------*/
 extern void eph2pos(gtime_t time, const eph_t* eph, double* rs, double* dts,
     double* var)
+{
+    double rsv[6], dtsv[2];
+    int i;
+
+    rsv[0] = rsv[1] = rsv[2] = dtsv[0] = 0.0;
+    eph2posvel(time, eph, rsv, dtsv, var);
+    for (i = 0; i < 3; i++) rs[i] = rsv[i];
+    *dts = dtsv[0];
+}
+/* broadcast ephemeris to satellite position/velocity and clock bias/drift -----
+* compute satellite position, velocity, clock bias and clock drift with
+* broadcast ephemeris (gps, galileo, qzss)
+* args   : gtime_t time     I   time (gpst)
+*          eph_t *eph       I   broadcast ephemeris
+*          double *rs       O   satellite position/velocity (ecef)
+*                               {x,y,z,vx,vy,vz} (m|m/s)
+*          double *dts      O   satellite clock {bias,drift} (s|s/s)
+*          double *var      O   satellite position and clock variance (m^2)
+* return : none
+* notes  : same as eph2pos(). velocity and clock drift are the analytic time
+*          derivatives of the position and clock of eph2pos()
+*-----------------------------------------------------------------------------*/
+extern void eph2posvel(gtime_t time, const eph_t* eph, double* rs, double* dts,
+    double* var)
 {
     double tk, M, E, Ek, sinE, cosE, u, r, i, O, sin2u, cos2u, x, y, sinO, cosO, cosi, mu, omge;
-    double xg, yg, zg, sino, coso;
-    int n, sys, prn;
+    double xg, yg, zg, sino, coso, sini, cosu, sinu, n0, sq1e2;
+    double Ed, ud, rd, id, Od, xd, yd, xgd, ygd, zgd, w, wd;
+    int n, sys, prn, geo;
 
     if (eph->A <= 0.0) {
-        rs[0] = rs[1] = rs[2] = *dts = *var = 0.0;
+        rs[0] = rs[1] = rs[2] = rs[3] = rs[4] = rs[5] = dts[0] = dts[1] = *var = 0.0;
         return;
     }
     tk = timediff(time, eph->toe);
@@ -228,7 +259,9 @@ extern void eph2pos(gtime_t time, const eph_t* eph, double* rs, double* dts,
     case SYS_CMP: mu = MU_CMP; omge = OMGE_CMP; break;
     default:      mu = MU_GPS; omge = OMGE;     break;
     }
-    M = eph->M0 + (sqrt(mu / (eph->A * eph->A * eph->A)) + eph->deln) * tk;
+    geo = sys == SYS_CMP && (prn <= 5 || prn >= 59); // beidou geo satellite
+    n0 = sqrt(mu / (eph->A * eph->A * eph->A)) + eph->deln;
+    M = eph->M0 + n0 * tk;
 
     for (n = 0, E = M, Ek = 0.0; fabs(E - Ek) > RTOL_KEPLER && n < MAX_ITER_KEPLER; n++) {
         Ek = E; E -= (E - eph->e * sin(E) - M) / (1.0 - eph->e * cos(E));
@@ -239,44 +272,411 @@ extern void eph2pos(gtime_t time, const eph_t* eph, double* rs, double* dts,
         return;
     }
     sinE = sin(E); cosE = cos(E);
+    sq1e2 = sqrt(1.0 - eph->e * eph->e);
 
-    u = atan2(sqrt(1.0 - eph->e * eph->e) * sinE, cosE - eph->e) + eph->omg;
+    u = atan2(sq1e2 * sinE, cosE - eph->e) + eph->omg;
     r = eph->A * (1.0 - eph->e * cosE);
     i = eph->i0 + eph->idot * tk;
     sin2u = sin(2.0 * u); cos2u = cos(2.0 * u);
+
+    /* rates of eccentric anomaly, argument of latitude, radius, inclination */
+    Ed = n0 / (1.0 - eph->e * cosE);
+    ud = sq1e2 * Ed / (1.0 - eph->e * cosE);
+    rd = eph->A * eph->e * sinE * Ed + 2.0 * ud * (eph->crs * cos2u - eph->crc * sin2u);
+    id = eph->idot + 2.0 * ud * (eph->cis * cos2u - eph->cic * sin2u);
+    ud *= 1.0 + 2.0 * (eph->cus * cos2u - eph->cuc * sin2u);
+
     u += eph->cus * sin2u + eph->cuc * cos2u;
     r += eph->crs * sin2u + eph->crc * cos2u;
     i += eph->cis * sin2u + eph->cic * cos2u;
-    x = r * cos(u); y = r * sin(u); cosi = cos(i);
+    cosu = cos(u); sinu = sin(u);
+    x = r * cosu; y = r * sinu; cosi = cos(i); sini = sin(i);
+    xd = rd * cosu - y * ud;
+    yd = rd * sinu + x * ud;
 
     /* beidou geo satellite (ref [9]) */
-    if (sys == SYS_CMP && prn <= 5||prn>=59 ) {
+    if (geo) {
         O = eph->OMG0 + eph->OMGd * tk - omge * eph->toes;
-        sinO = sin(O); cosO = cos(O);
-        xg = x * cosO - y * cosi * sinO;
-        yg = x * sinO + y * cosi * cosO;
-        zg = y * sin(i);
+        Od = eph->OMGd;
+    }
+    else {
+        O = eph->OMG0 + (eph->OMGd - omge) * tk - omge * eph->toes;
+        Od = eph->OMGd - omge;
+    }
+    sinO = sin(O); cosO = cos(O);
+    xg = x * cosO - y * cosi * sinO;
+    yg = x * sinO + y * cosi * cosO;
+    zg = y * sini;
+    xgd = xd * cosO - yd * cosi * sinO + y * sini * id * sinO - Od * yg;
+    ygd = xd * sinO + yd * cosi * cosO - y * sini * id * cosO + Od * xg;
+    zgd = yd * sini + y * cosi * id;
+
+    if (geo) {
         sino = sin(omge * tk); coso = cos(omge * tk);
-        rs[0] = xg * coso + yg * sino * COS_5 + zg * sino * SIN_5;
-        rs[1] = -xg * sino + yg * coso * COS_5 + zg * coso * SIN_5;
+        w = yg * COS_5 + zg * SIN_5;
+        wd = ygd * COS_5 + zgd * SIN_5;
+        rs[0] = xg * coso + w * sino;
+        rs[1] = -xg * sino + w * coso;
         rs[2] = -yg * SIN_5 + zg * COS_5;
+        rs[3] = xgd * coso + wd * sino + omge * rs[1];
+        rs[4] = -xgd * sino + wd * coso - omge * rs[0];
+        rs[5] = -ygd * SIN_5 + zgd * COS_5;
     }
     else {
-        O = eph->OMG0 + (eph->OMGd - omge) * tk - omge * eph->toes;
-        sinO = sin(O); cosO = cos(O);
-        rs[0] = x * cosO - y * cosi * sinO;
-        rs[1] = x * sinO + y * cosi * cosO;
-        rs[2] = y * sin(i);
+        rs[0] = xg; rs[1] = yg; rs[2] = zg;
+        rs[3] = xgd; rs[4] = ygd; rs[5] = zgd;
     }
     tk = timediff(time, eph->toc);
-    *dts = eph->f0 + eph->f1 * tk + eph->f2 * tk * tk;
+    dts[0] = eph->f0 + eph->f1 * tk + eph->f2 * tk * tk;
+    dts[1] = eph->f1 + 2.0 * eph->f2 * tk;
 
     /* relativity correction */
-    *dts -= 2.0 * sqrt(mu * eph->A) * eph->e * sinE / SQR(CLIGHT);
+    dts[0] -= 2.0 * sqrt(mu * eph->A) * eph->e * sinE / SQR(CLIGHT);
+    dts[1] -= 2.0 * sqrt(mu * eph->A) * eph->e * cosE * Ed / SQR(CLIGHT);
 
     /* position and clock error variance */
     *var = var_uraeph(eph->sva);
 }
+/* broadcast ephemerides by element for batch propagation --------------------*/
+typedef struct {
+    double tk[NBATCH],A[NBATCH],dA[NBATCH],e[NBATCH],M[NBATCH],nd[NBATCH];
+    double omg[NBATCH],i[NBATCH],idot[NBATCH],cuc[NBATCH],cus[NBATCH];
+    double crc[NBATCH],crs[NBATCH],cic[NBATCH],cis[NBATCH];
+    double O[NBATCH],Od[NBATCH],we[NBATCH],geo[NBATCH];
+    double tc[NBATCH],f0[NBATCH],f1[NBATCH],f2[NBATCH],rel[NBATCH];
+    double rs[6][NBATCH],dts[2][NBATCH]; /* position/velocity and clock */
+    int stat[NBATCH];                    /* status (1:ok,0:kepler error) */
+} ephsoa_t;
+
+/* propagate broadcast ephemeris of batch element ----------------------------*/
+static void posvel1(ephsoa_t *s, int j)
+{
+    double E,Ek,sinE,cosE,sq1e2,u,r,i,sin2u,cos2u,cosu,sinu,cosi,sini,Ed,ud;
+    double rd,id,x,y,xd,yd,sinO,cosO,xg,yg,zg,xgd,ygd,zgd,w,wd,sino,coso,ec;
+    int n;
+    
+    ec=s->e[j];
+    for (n=0,E=s->M[j],Ek=0.0;fabs(E-Ek)>RTOL_KEPLER&&n<MAX_ITER_KEPLER;n++) {
+        Ek=E; E-=(E-ec*sin(E)-s->M[j])/(1.0-ec*cos(E));
+    }
+    if (!(s->stat[j]=n<MAX_ITER_KEPLER)) return;
+    
+    sinE=sin(E); cosE=cos(E);
+    sq1e2=sqrt(1.0-ec*ec);
+    u=atan2(sq1e2*sinE,cosE-ec)+s->omg[j];
+    r=s->A[j]*(1.0-ec*cosE);
+    i=s->i[j];
+    sin2u=sin(2.0*u); cos2u=cos(2.0*u);
+    
+    Ed=s->nd[j]/(1.0-ec*cosE);
+    ud=sq1e2*Ed/(1.0-ec*cosE);
+    rd=s->dA[j]*(1.0-ec*cosE)+s->A[j]*ec*sinE*Ed+
+       2.0*ud*(s->crs[j]*cos2u-s->crc[j]*sin2u);
+    id=s->idot[j]+2.0*ud*(s->cis[j]*cos2u-s->cic[j]*sin2u);
+    ud*=1.0+2.0*(s->cus[j]*cos2u-s->cuc[j]*sin2u);
+    
+    u+=s->cus[j]*sin2u+s->cuc[j]*cos2u;
+    r+=s->crs[j]*sin2u+s->crc[j]*cos2u;
+    i+=s->cis[j]*sin2u+s->cic[j]*cos2u;
+    cosu=cos(u); sinu=sin(u); cosi=cos(i); sini=sin(i);
+    x=r*cosu; y=r*sinu;
+    xd=rd*cosu-y*ud;
+    yd=rd*sinu+x*ud;
+    
+    sinO=sin(s->O[j]); cosO=cos(s->O[j]);
+    xg=x*cosO-y*cosi*sinO;
+    yg=x*sinO+y*cosi*cosO;
+    zg=y*sini;
+    xgd=xd*cosO-yd*cosi*sinO+y*sini*id*sinO-s->Od[j]*yg;
+    ygd=xd*sinO+yd*cosi*cosO-y*sini*id*cosO+s->Od[j]*xg;
+    zgd=yd*sini+y*cosi*id;
+    
+    if (s->geo[j]!=0.0) { /* bds geo satellite */
+        sino=sin(s->we[j]*s->tk[j]); coso=cos(s->we[j]*s->tk[j]);
+        w =yg *COS_5+zg *SIN_5;
+        wd=ygd*COS_5+zgd*SIN_5;
+        s->rs[0][j]=xg*coso+w*sino;
+        s->rs[1][j]=-xg*sino+w*coso;
+        s->rs[2][j]=-yg*SIN_5+zg*COS_5;
+        s->rs[3][j]=xgd*coso+wd*sino+s->we[j]*s->rs[1][j];
+        s->rs[4][j]=-xgd*sino+wd*coso-s->we[j]*s->rs[0][j];
+        s->rs[5][j]=-ygd*SIN_5+zgd*COS_5;
+    }
+    else {
+        s->rs[0][j]=xg;  s->rs[1][j]=yg;  s->rs[2][j]=zg;
+        s->rs[3][j]=xgd; s->rs[4][j]=ygd; s->rs[5][j]=zgd;
+    }
+    s->dts[0][j]=s->f0[j]+s->f1[j]*s->tc[j]+s->f2[j]*s->tc[j]*s->tc[j]-
+                 s->rel[j]*ec*sinE;
+    s->dts[1][j]=s->f1[j]+2.0*s->f2[j]*s->tc[j]-s->rel[j]*ec*cosE*Ed;
+}
+#ifdef ENASIMD
+/* simd (avx2) kernel of batch propagation -----------------------------------*/
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+#define PIO2_1   1.57079632679489655800E+00 /* pi/2 in three parts */
+#define PIO2_2   6.12323399573676603587E-17
+#define PIO2_3  -1.49738490485916983665E-33
+
+#define VSET(x)      _mm256_set1_pd(x)
+#define VADD(a,b)    _mm256_add_pd(a,b)
+#define VSUB(a,b)    _mm256_sub_pd(a,b)
+#define VMUL(a,b)    _mm256_mul_pd(a,b)
+#define VDIV(a,b)    _mm256_div_pd(a,b)
+#define VFMA(a,b,c)  _mm256_fmadd_pd(a,b,c)  /* a*b+c */
+#define VFNMA(a,b,c) _mm256_fnmadd_pd(a,b,c) /* c-a*b */
+
+/* cpu supports avx2 and fma -------------------------------------------------*/
+static int cpuavx2(void)
+{
+    static int stat=-1;
+    
+    if (stat<0) {
+        __builtin_cpu_init();
+        stat=__builtin_cpu_supports("avx2")&&__builtin_cpu_supports("fma");
+    }
+    return stat;
+}
+/* sine and cosine of 4 angles -------------------------------------------------
+* args   : __m256d x        I   angles (rad) (|x|<2^20)
+*          __m256d *s,*c    O   sine and cosine
+* notes  : reduction by pi/2 in three parts with fma and polynomials of
+*          __kernel_sin() and __kernel_cos() of fdlibm on [-pi/4,pi/4]
+*-----------------------------------------------------------------------------*/
+TARGET_AVX2 static void sincos4(__m256d x, __m256d *s, __m256d *c)
+{
+    const __m256d one=VSET(1.0),sign=VSET(-0.0);
+    __m256d q,r,z,w,ps,pc,qm,sw,ns,nc;
+    
+    q=_mm256_round_pd(VMUL(x,VSET(2.0/PI)),
+                      _MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+    r=VFNMA(q,VSET(PIO2_1),x);
+    r=VFNMA(q,VSET(PIO2_2),r);
+    r=VFNMA(q,VSET(PIO2_3),r);
+    z=VMUL(r,r);
+    
+    ps=VFMA(z,VSET( 1.58969099521155010221E-10),VSET(-2.50507602534068634195E-08));
+    ps=VFMA(z,ps,VSET( 2.75573137070700676789E-06));
+    ps=VFMA(z,ps,VSET(-1.98412698298579493134E-04));
+    ps=VFMA(z,ps,VSET( 8.33333333332248946124E-03));
+    ps=VFMA(z,ps,VSET(-1.66666666666666324348E-01));
+    ps=VFMA(VMUL(r,z),ps,r);
+    
+    pc=VFMA(z,VSET(-1.13596475577881948265E-11),VSET( 2.08757232129817482790E-09));
+    pc=VFMA(z,pc,VSET(-2.75573143513906633035E-07));
+    pc=VFMA(z,pc,VSET( 2.48015872894767294178E-05));
+    pc=VFMA(z,pc,VSET(-1.38888888888741095749E-03));
+    pc=VFMA(z,pc,VSET( 4.16666666666666019037E-02));
+    w=VFNMA(z,VSET(0.5),one);
+    pc=VADD(w,VFMA(VMUL(z,z),pc,VFNMA(z,VSET(0.5),VSUB(one,w))));
+    
+    /* quadrant (0-3): swap sin/cos by odd and set signs */
+    qm=VFNMA(VSET(4.0),_mm256_floor_pd(VMUL(q,VSET(0.25))),q);
+    sw=_mm256_or_pd(_mm256_cmp_pd(qm,VSET(1.0),_CMP_EQ_OQ),
+                    _mm256_cmp_pd(qm,VSET(3.0),_CMP_EQ_OQ));
+    ns=_mm256_cmp_pd(qm,VSET(2.0),_CMP_GE_OQ);
+    nc=_mm256_or_pd(_mm256_cmp_pd(qm,VSET(1.0),_CMP_EQ_OQ),
+                    _mm256_cmp_pd(qm,VSET(2.0),_CMP_EQ_OQ));
+    *s=_mm256_xor_pd(_mm256_blendv_pd(ps,pc,sw),_mm256_and_pd(ns,sign));
+    *c=_mm256_xor_pd(_mm256_blendv_pd(pc,ps,sw),_mm256_and_pd(nc,sign));
+}
+/* propagate broadcast ephemerides of 4 batch elements -------------------------
+* same as posvel1() with kepler equation by fixed NITER_KEPLER iterations and
+* argument of latitude by the true anomaly without atan2(). stat is set to 0
+* for elements whose last newton step exceeds RTOL_KEPLER.
+*-----------------------------------------------------------------------------*/
+TARGET_AVX2 static void posvel4(ephsoa_t *s, int j)
+{
+    const __m256d one=VSET(1.0),two=VSET(2.0);
+    __m256d ec,M,E,d,sE,cE,den,sq,sv,cv,sw,cw,su,cu,s2u,c2u,A,r,i,Ed,ud,rd,id;
+    __m256d du,sd,cd,si,ci,xo,yo,xd,yd,sO,cO,Od,xg,yg,zg,xgd,ygd,zgd,we,so,co;
+    __m256d w,wd,g,rs[6],tc,f1,f2,rel,ok;
+    int k,m;
+    
+    ec=_mm256_loadu_pd(s->e+j);
+    M =_mm256_loadu_pd(s->M+j);
+    
+    /* kepler equation by fixed newton iterations */
+    for (k=0,E=M,d=VSET(0.0);k<NITER_KEPLER;k++) {
+        sincos4(E,&sE,&cE);
+        d=VDIV(VSUB(VFNMA(ec,sE,E),M),VFNMA(ec,cE,one));
+        E=VSUB(E,d);
+    }
+    ok=_mm256_cmp_pd(_mm256_andnot_pd(VSET(-0.0),d),VSET(RTOL_KEPLER),_CMP_LE_OQ);
+    sincos4(E,&sE,&cE);
+    
+    /* true anomaly and argument of latitude */
+    den=VFNMA(ec,cE,one);
+    sq=_mm256_sqrt_pd(VFNMA(ec,ec,one));
+    cv=VDIV(VSUB(cE,ec),den);
+    sv=VDIV(VMUL(sq,sE),den);
+    sincos4(_mm256_loadu_pd(s->omg+j),&sw,&cw);
+    su=VFMA(sv,cw,VMUL(cv,sw));
+    cu=VFNMA(sv,sw,VMUL(cv,cw));
+    s2u=VMUL(two,VMUL(su,cu));
+    c2u=VMUL(VSUB(cu,su),VADD(cu,su));
+    
+    A=_mm256_loadu_pd(s->A+j);
+    r=VMUL(A,den);
+    Ed=VDIV(_mm256_loadu_pd(s->nd+j),den);
+    ud=VDIV(VMUL(sq,Ed),den);
+    rd=VFMA(_mm256_loadu_pd(s->dA+j),den,VMUL(VMUL(A,ec),VMUL(sE,Ed)));
+    rd=VFMA(VMUL(two,ud),VFNMA(_mm256_loadu_pd(s->crc+j),s2u,
+            VMUL(_mm256_loadu_pd(s->crs+j),c2u)),rd);
+    id=VFMA(VMUL(two,ud),VFNMA(_mm256_loadu_pd(s->cic+j),s2u,
+            VMUL(_mm256_loadu_pd(s->cis+j),c2u)),_mm256_loadu_pd(s->idot+j));
+    ud=VMUL(ud,VFMA(two,VFNMA(_mm256_loadu_pd(s->cuc+j),s2u,
+            VMUL(_mm256_loadu_pd(s->cus+j),c2u)),one));
+    
+    du=VFMA(_mm256_loadu_pd(s->cus+j),s2u,VMUL(_mm256_loadu_pd(s->cuc+j),c2u));
+    r =VADD(r,VFMA(_mm256_loadu_pd(s->crs+j),s2u,VMUL(_mm256_loadu_pd(s->crc+j),c2u)));
+    i =VADD(_mm256_loadu_pd(s->i+j),
+            VFMA(_mm256_loadu_pd(s->cis+j),s2u,VMUL(_mm256_loadu_pd(s->cic+j),c2u)));
+    sincos4(du,&sd,&cd);
+    sincos4(i,&si,&ci);
+    sw=VFMA(su,cd,VMUL(cu,sd)); /* sin(u+du) */
+    cw=VFNMA(su,sd,VMUL(cu,cd)); /* cos(u+du) */
+    xo=VMUL(r,cw); yo=VMUL(r,sw);
+    xd=VFNMA(yo,ud,VMUL(rd,cw));
+    yd=VFMA (xo,ud,VMUL(rd,sw));
+    
+    /* rotation by longitude of ascending node and inclination */
+    sincos4(_mm256_loadu_pd(s->O+j),&sO,&cO);
+    Od=_mm256_loadu_pd(s->Od+j);
+    xg=VFNMA(VMUL(yo,ci),sO,VMUL(xo,cO));
+    yg=VFMA (VMUL(yo,ci),cO,VMUL(xo,sO));
+    zg=VMUL(yo,si);
+    xgd=VFNMA(Od,yg,VFMA(VMUL(yo,si),VMUL(id,sO),VFNMA(VMUL(yd,ci),sO,VMUL(xd,cO))));
+    ygd=VFMA (Od,xg,VFNMA(VMUL(yo,si),VMUL(id,cO),VFMA(VMUL(yd,ci),cO,VMUL(xd,sO))));
+    zgd=VFMA(VMUL(yo,ci),id,VMUL(yd,si));
+    
+    /* bds geo rotation selected by mask */
+    g =_mm256_cmp_pd(_mm256_loadu_pd(s->geo+j),VSET(0.0),_CMP_NEQ_OQ);
+    we=_mm256_loadu_pd(s->we+j);
+    sincos4(VMUL(we,_mm256_loadu_pd(s->tk+j)),&so,&co);
+    w =VFMA(yg ,VSET(COS_5),VMUL(zg ,VSET(SIN_5)));
+    wd=VFMA(ygd,VSET(COS_5),VMUL(zgd,VSET(SIN_5)));
+    rs[0]=VFMA(xg,co,VMUL(w,so));
+    rs[1]=VFNMA(xg,so,VMUL(w,co));
+    rs[2]=VFNMA(yg,VSET(SIN_5),VMUL(zg,VSET(COS_5)));
+    rs[3]=VFMA(we,rs[1],VFMA(xgd,co,VMUL(wd,so)));
+    rs[4]=VFNMA(we,rs[0],VFNMA(xgd,so,VMUL(wd,co)));
+    rs[5]=VFNMA(ygd,VSET(SIN_5),VMUL(zgd,VSET(COS_5)));
+    _mm256_storeu_pd(s->rs[0]+j,_mm256_blendv_pd(xg ,rs[0],g));
+    _mm256_storeu_pd(s->rs[1]+j,_mm256_blendv_pd(yg ,rs[1],g));
+    _mm256_storeu_pd(s->rs[2]+j,_mm256_blendv_pd(zg ,rs[2],g));
+    _mm256_storeu_pd(s->rs[3]+j,_mm256_blendv_pd(xgd,rs[3],g));
+    _mm256_storeu_pd(s->rs[4]+j,_mm256_blendv_pd(ygd,rs[4],g));
+    _mm256_storeu_pd(s->rs[5]+j,_mm256_blendv_pd(zgd,rs[5],g));
+    
+    /* clock bias/drift with relativity correction */
+    tc =_mm256_loadu_pd(s->tc+j);
+    f1 =_mm256_loadu_pd(s->f1+j);
+    f2 =_mm256_loadu_pd(s->f2+j);
+    rel=VMUL(_mm256_loadu_pd(s->rel+j),ec);
+    _mm256_storeu_pd(s->dts[0]+j,VFNMA(rel,sE,VFMA(VFMA(f2,tc,f1),tc,
+                                               _mm256_loadu_pd(s->f0+j))));
+    _mm256_storeu_pd(s->dts[1]+j,VFNMA(VMUL(rel,cE),Ed,VFMA(VMUL(two,f2),tc,f1)));
+    
+    m=_mm256_movemask_pd(ok);
+    for (k=0;k<4;k++) s->stat[j+k]=(m>>k)&1;
+}
+#endif /* ENASIMD */
+/* broadcast ephemerides to satellite positions/velocities in batch -----------
+* compute satellite positions, velocities, clock biases and clock drifts of
+* multiple broadcast ephemerides (gps, galileo, qzss, bds)
+* args   : gtime_t *time    I   times (gpst)
+*          eph_t  **eph     I   broadcast ephemerides (NULL: skip)
+*          int    n         I   number of ephemerides
+*          double *rs       O   satellite positions/velocities (ecef)
+*                               rs [(0:5)+i*6]={x,y,z,vx,vy,vz} (m|m/s)
+*          double *dts      O   satellite clocks
+*                               dts[(0:1)+i*2]={bias,drift} (s|s/s)
+*          double *var      O   satellite position and clock variances (m^2)
+* return : none
+* notes  : same as eph2posvel() for gps, galileo and qzss and eph2posvel_CNAV()
+*          for bds. ephemerides are gathered into arrays by element and
+*          propagated by the avx2 kernel 4 elements at a time if the cpu
+*          supports avx2 and fma, otherwise by the scalar code. the kernel
+*          solves kepler equation by fixed iterations, and the elements not
+*          converged there are propagated again by the scalar code.
+*          outputs of unconverged Kepler equation are not changed.
+*          the kernel is built by gcc or clang for x86 (-DNOSIMD: not built).
+*-----------------------------------------------------------------------------*/
+extern void eph2posvels(const gtime_t *time, const eph_t **eph, int n,
+                        double *rs, double *dts, double *var)
+{
+    ephsoa_t s;
+    const eph_t *e;
+    double mu,omge,n0;
+    int idx[NBATCH],i,k,m,j,sys,prn,cnav,simd=0;
+    
+#ifdef ENASIMD
+    simd=cpuavx2();
+#endif
+    for (k=0;k<n;) {
+        memset(&s,0,sizeof(s));
+        
+        /* gather ephemerides into arrays by element */
+        for (m=0;k<n&&m<NBATCH;k++) {
+            if (!(e=eph[k])) continue;
+            if (e->A<=0.0) {
+                for (j=0;j<6;j++) rs[j+k*6]=0.0;
+                dts[k*2]=dts[1+k*2]=var[k]=0.0;
+                continue;
+            }
+            switch ((sys=satsys(e->sat,&prn))) {
+                case SYS_GAL: mu=MU_GAL; omge=OMGE_GAL; break;
+                case SYS_CMP: mu=MU_CMP; omge=OMGE_CMP; break;
+                default:      mu=MU_GPS; omge=OMGE;     break;
+            }
+            /* bds by cnav (see eph2posvel_CNAV()) */
+            cnav=sys==SYS_CMP;
+            s.geo[m]=sys==SYS_CMP&&(prn<=5||prn>=59);
+            
+            s.tk[m]=timediff(time[k],e->toe);
+            if (cnav) {
+                if (s.tk[m]> 302400.0) s.tk[m]-=604800.0;
+                if (s.tk[m]<-302400.0) s.tk[m]+=604800.0;
+            }
+            n0=sqrt(mu/(e->A*e->A*e->A));
+            s.dA[m]=cnav?e->dotA:0.0;
+            s.A [m]=cnav?e->A+e->dotA*s.tk[m]:e->A;
+            s.M [m]=cnav?e->M0+(n0+(e->deln+e->dotn*s.tk[m]/2))*s.tk[m]:
+                         e->M0+(n0+e->deln)*s.tk[m];
+            s.nd[m]=cnav?n0+e->deln+e->dotn*s.tk[m]:n0+e->deln;
+            s.e[m]=e->e; s.omg[m]=e->omg; s.i[m]=e->i0+e->idot*s.tk[m];
+            s.idot[m]=e->idot;
+            s.cuc[m]=e->cuc; s.cus[m]=e->cus; s.crc[m]=e->crc; s.crs[m]=e->crs;
+            s.cic[m]=e->cic; s.cis[m]=e->cis;
+            s.Od[m]=s.geo[m]!=0.0?e->OMGd:e->OMGd-omge;
+            s.O [m]=e->OMG0+s.Od[m]*s.tk[m]-omge*e->toes;
+            s.we[m]=omge;
+            s.tc[m]=timediff(time[k],e->toc);
+            s.f0[m]=e->f0; s.f1[m]=e->f1; s.f2[m]=e->f2;
+            s.rel[m]=2.0*sqrt(mu*e->A)/SQR(CLIGHT);
+            idx[m++]=k;
+        }
+#ifdef ENASIMD
+        /* 4 elements at a time (padded elements are zeros) */
+        for (j=0;simd&&j<m;j+=4) posvel4(&s,j);
+#endif
+        for (j=0;j<m;j++) {
+            if (!simd||!s.stat[j]) posvel1(&s,j);
+        }
+        /* scatter converged solutions */
+        for (j=0;j<m;j++) {
+            if (!s.stat[j]) {
+                trace(2,"eph2posvels: kepler iteration overflow sat=%2d\n",
+                      eph[idx[j]]->sat);
+                continue;
+            }
+            for (i=0;i<6;i++) rs[i+idx[j]*6]=s.rs[i][j];
+            dts[idx[j]*2]=s.dts[0][j]; dts[1+idx[j]*2]=s.dts[1][j];
+            var[idx[j]]=var_uraeph(eph[idx[j]]->sva);
+        }
+    }
+}
 /* glonass orbit differential equations --------------------------------------*/
 static void deq(const double *x, double *xdot, const double *acc)
 {
@@ -413,8 +813,9 @@ extern void seph2pos(gtime_t time, const seph_t *seph, double *rs, double *dts,
 /* select ephememeris --------------------------------------------------------*/
 static eph_t *seleph(gtime_t time, int sat, int iode, const nav_t *nav)
 {
+    const int *idx;
     double t,tmax,tmin;
-    int i,j=-1,sys,sel;
+    int i,j=-1,k,n,sys,sel;
     
     trace(4,"seleph  : time=%s sat=%2d iode=%d\n",time_str(time,3),sat,iode);
     
@@ -429,7 +830,11 @@ static eph_t *seleph(gtime_t time, int sat, int iode, const nav_t *nav)
     }
     tmin=tmax+1.0;
     
-    for (i=0;i<nav->n;i++) {
+    /* ephemerides within toe window by index or all ephemerides */
+    if (!(idx=searcheph(nav,sat,time,tmax,&n))) n=nav->n;
+    
+    for (k=0;k<n;k++) {
+        i=idx?idx[k]:k;
         if (nav->eph[i].sat!=sat) continue;
         if (iode>=0&&nav->eph[i].iode!=iode) continue;
         if (sys==SYS_GAL) {
@@ -439,10 +844,14 @@ static eph_t *seleph(gtime_t time, int sat, int iode, const nav_t *nav)
             if (timediff(nav->eph[i].toe,time)>=0.0) continue; /* AOD<=0 */
         }
         if ((t=fabs(timediff(nav->eph[i].toe,time)))>tmax) continue;
-        if (iode>=0) return nav->eph+i;
-        if (t<=tmin) {j=i; tmin=t;} /* toe closest to time */
+        if (iode>=0) { /* first in ephemeris order */
+            if (j<0||i<j) j=i;
+            if (!idx) break;
+            continue;
+        }
+        if (t<tmin||(t==tmin&&i>j)) {j=i; tmin=t;} /* toe closest to time */
     }
-    if (iode>=0||j<0) {
+    if (j<0) {
         trace(3,"no broadcast ephemeris: %s sat=%2d iode=%3d\n",
               time_str(time,0),sat,iode);
         return NULL;
@@ -581,20 +990,18 @@ extern int ephpos(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
     //GCC
     // Handling different satellite systems (Beidou, GPS, Galileo, QZSS, GLONASS)
     if (sys == SYS_CMP) {
-        // For BeiDou (SYS_CMP), select the ephemeris and compute the satellite position and clock bias
+        // For BeiDou (SYS_CMP), select the ephemeris and compute the satellite position, velocity, clock bias and drift
         if (!(eph = seleph(teph, sat, iode, nav))) return 0;  // Select BeiDou ephemeris
-        eph2pos_CNAV(time, eph, rs, dts, var);  // Compute satellite position and clock
-        time = timeadd(time, tt);  // Add small time increment for velocity calculation
-        eph2pos_CNAV(time, eph, rst, dtst, var);  // Compute position again for velocity calculation
+        eph2posvel_CNAV(time, eph, rs, dts, var);  // Compute satellite position/velocity and clock bias/drift
         *svh = eph->svh;  // Set the satellite health status
+        return 1;
     }
     else if (sys == SYS_GPS || sys == SYS_GAL || sys == SYS_QZS) {
-        // For GPS, Galileo, and QZSS (SYS_GPS, SYS_GAL, SYS_QZS), select the ephemeris and compute the satellite position and clock bias
+        // For GPS, Galileo, and QZSS (SYS_GPS, SYS_GAL, SYS_QZS), select the ephemeris and compute the satellite position, velocity, clock bias and drift
         if (!(eph = seleph(teph, sat, iode, nav))) return 0;  // Select GPS/Galileo/QZSS ephemeris
-        eph2pos(time, eph, rs, dts, var);  // Compute satellite position and clock
-        time = timeadd(time, tt);  // Add small time increment for velocity calculation
-        eph2pos(time, eph, rst, dtst, var);  // Compute position again for velocity calculation
+        eph2posvel(time, eph, rs, dts, var);  // Compute satellite position/velocity and clock bias/drift
         *svh = eph->svh;  // Set the satellite health status
+        return 1;
     }
     else if (sys == SYS_GLO) {
         // For GLONASS (SYS_GLO), select the ephemeris and compute the satellite position and clock bias
@@ -606,7 +1013,7 @@ extern int ephpos(gtime_t time, gtime_t teph, int sat, const nav_t* nav,
     }
     else return 0;  // Return 0 if the satellite system is not recognized
 
-    /* Satellite velocity and clock drift calculation by differential approximation */
+    /* GLONASS satellite velocity and clock drift calculation by differential approximation */
     for (i = 0; i < 3; i++) rs[i + 3] = (rst[i] - rs[i]) / tt;  // Compute satellite velocity (differential of position over time increment)
     dts[1] = (dtst[0] - dts[0]) / tt;  // Compute clock drift (differential of clock bias over time increment)
 
@@ -777,6 +1184,38 @@ extern int satpos(gtime_t time, gtime_t teph, int sat, int ephopt,
     *svh=-1;
     return 0;
 }
+/* select broadcast ephemeris for satellite position in batch -----------------
+* select broadcast ephemeris of satellite position by eph2posvels() for
+* ephemeris option of broadcast or b2b (gps, galileo, qzss and bds)
+* args   : gtime_t time     I   time (gpst)
+*          gtime_t teph     I   time to select ephemeris (gpst)
+*          int    sat       I   satellite number
+*          int    ephopt    I   ephemeris option (EPHOPT_???)
+*          nav_t  *nav      I   navigation data
+*          eph_t  **eph     O   broadcast ephemeris (NULL: no ephemeris)
+*          b2bsatp_t **b2b  O   b2b correction (NULL: no valid correction)
+* return : status (1:by batch,0:by satpos())
+*-----------------------------------------------------------------------------*/
+static int selbatch(gtime_t time, gtime_t teph, int sat, int ephopt,
+                    const nav_t *nav, const eph_t **eph, const b2bsatp_t **b2b)
+{
+    int sys=satsys(sat,NULL);
+    
+    if (sys!=SYS_GPS&&sys!=SYS_GAL&&sys!=SYS_QZS&&sys!=SYS_CMP) return 0;
+    
+    /* b2b corrected orbit cache by satpos() */
+    if (ephopt==EPHOPT_B2b&&nav->b2bsat.cache) return 0;
+    
+    if (ephopt==EPHOPT_B2b&&(*b2b=selB2bcorr(time,sat,nav))) {
+        *eph=selB2beph(teph,sat,(*b2b)->b2btype2.IODN,nav);
+    }
+    else if (ephopt==EPHOPT_BRDC||ephopt==EPHOPT_B2b) {
+        *eph=seleph(teph,sat,-1,nav);
+    }
+    else return 0;
+    
+    return 1;
+}
 /* satellite positions and clocks ----------------------------------------------
 * compute satellite positions, velocities and clocks
 * args   : gtime_t teph     I   time to select ephemeris (gpst)
@@ -805,8 +1244,10 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
                     int ephopt, double *rs, double *dts, double *var, int *svh)
 {
     gtime_t time[2*MAXOBS]={{0}};
+    const eph_t *eph[2*MAXOBS]={0};
+    const b2bsatp_t *b2b[2*MAXOBS]={0};
     double dt,pr;
-    int i,j;
+    int i,j,batch[2*MAXOBS]={0};
     
     trace(3,"satposs : teph=%s n=%d ephopt=%d\n",time_str(teph,3),n,ephopt);
     
@@ -832,6 +1273,10 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
         }
         time[i]=timeadd(time[i],-dt);
         
+        /* broadcast ephemeris propagated in batch */
+        if ((batch[i]=selbatch(time[i],teph,obs[i].sat,ephopt,nav,eph+i,b2b+i))) {
+            continue;
+        }
         /* satellite position and clock at transmission time */
         if (!satpos(time[i],teph,obs[i].sat,ephopt,nav,rs+i*6,dts+i*2,var+i,
                     svh+i)) {
@@ -842,7 +1287,39 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
         if (dts[i*2]==0.0) {
             if (!ephclk(time[i],teph,obs[i].sat,nav,dts+i*2)) continue;
             dts[1+i*2]=0.0;
-            *var=SQR(STD_BRDCCLK);
+            var[i]=SQR(STD_BRDCCLK);
+        }
+    }
+    /* satellite positions and clocks by broadcast ephemerides in batch */
+    eph2posvels(time,eph,i,rs,dts,var);
+    
+    for (i=0;i<n&&i<2*MAXOBS;i++) {
+        if (!batch[i]) continue;
+        
+        if (!eph[i]) {
+            trace(3,"no ephemeris %s sat=%2d\n",time_str(time[i],3),obs[i].sat);
+            svh[i]=-1;
+            continue;
+        }
+        svh[i]=eph[i]->svh;
+        
+        /* b2b correction or broadcast ephemeris without valid correction */
+        if (ephopt==EPHOPT_B2b) {
+            if (!b2b[i]) {
+                svh[i]=-1;
+                continue;
+            }
+            if (!corrB2bpos(time[i],obs[i].sat,b2b[i],eph[i],rs+i*6,dts+i*2,
+                            var+i,svh+i)) {
+                trace(3,"no ephemeris %s sat=%2d\n",time_str(time[i],3),obs[i].sat);
+                continue;
+            }
+        }
+        /* if no precise clock available, use broadcast clock instead */
+        if (dts[i*2]==0.0) {
+            if (!ephclk(time[i],teph,obs[i].sat,nav,dts+i*2)) continue;
+            dts[1+i*2]=0.0;
+            var[i]=SQR(STD_BRDCCLK);
         }
     }
     for (i=0;i<n&&i<2*MAXOBS;i++) {
@@ -78,6 +78,9 @@ EXPORT opt_t sysopts[]={
     {"pos1-ionoopt",    3,  (void *)&prcopt_.ionoopt,    IONOPT },
     {"pos1-tropopt",    3,  (void *)&prcopt_.tropopt,    TRPOPT },
     {"pos1-sateph",     3,  (void *)&prcopt_.sateph,     EPHOPT },
+    {"pos1-b2bload",    3,  (void *)&prcopt_.b2bload,    SWTOPT },
+    {"pos1-b2bcache",   3,  (void *)&prcopt_.b2bcache,   SWTOPT },
+    {"pos1-navslide",   3,  (void *)&prcopt_.navslide,   SWTOPT },
     {"pos1-posopt1",    3,  (void *)&prcopt_.posopt[0],  SWTOPT },
     {"pos1-posopt2",    3,  (void *)&prcopt_.posopt[1],  SWTOPT },
     {"pos1-posopt3",    3,  (void *)&prcopt_.posopt[2],  PHWOPT },
@@ -183,6 +186,12 @@ EXPORT opt_t sysopts[]={
     {"file-geexefile",  2,  (void *)&filopt_.geexe,      ""     },
     {"file-solstatfile",2,  (void *)&filopt_.solstat,    ""     },
     {"file-tracefile",  2,  (void *)&filopt_.trace,      ""     },
+    {"file-b2bmaskfile",2,  (void *)&filopt_.b2bmask,    ""     },
+    {"file-b2borbfile", 2,  (void *)&filopt_.b2borb,     ""     },
+    {"file-b2bdcbfile", 2,  (void *)&filopt_.b2bdcb,     ""     },
+    {"file-b2bclkfile", 2,  (void *)&filopt_.b2bclk,     ""     },
+    {"file-b2bbinfile", 2,  (void *)&filopt_.b2bbin,     ""     },
+    {"file-rnx4navfile",2,  (void *)&filopt_.rnx4nav,    ""     },
     
     {"",0,NULL,""} /* terminator */
 };
@@ -500,6 +509,12 @@ extern void resetsysopts(void)
     filopt_.blq    [0]='\0';
     filopt_.solstat[0]='\0';
     filopt_.trace  [0]='\0';
+    filopt_.b2bmask[0]='\0';
+    filopt_.b2borb [0]='\0';
+    filopt_.b2bdcb [0]='\0';
+    filopt_.b2bclk [0]='\0';
+    filopt_.b2bbin [0]='\0';
+    filopt_.rnx4nav[0]='\0';
     for (i=0;i<2;i++) antpostype_[i]=0;
     elmask_=15.0;
     elmaskar_=0.0;
@@ -81,7 +81,11 @@ static FILE *fp_rtcm=NULL;      /* rtcm data file pointer */
 nav_t navs = { 0 };          /* navigation data */
 //GCC
 static int ib2b = 0;       // the current index of B2b
-extern b2b_t b2b;          /* sbas messages */
+b2b_t b2b = { 0 };         /* B2b messages */
+static b2b_reader_t b2breader={0}; /* B2b correction reader */
+static b2bhis_t b2bhis={0};        /* B2b correction history */
+static b2bcache_t b2bcache;        /* B2b orbit cache */
+static rnx4nav_t rnx4nav={0};      /* RINEX 4 navigation sliding window */
 
 
 
@@ -270,34 +274,20 @@ static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
         for (i=0;i<nu&&n<MAXOBS*2;i++) obs[n++]=obss.data[iobsu+i];
         for (i=0;i<nr&&n<MAXOBS*2;i++) obs[n++]=obss.data[iobsr+i];
         iobsu+=nu;
-
-        //GCC read B2b massages
-
-       //read type 1
-        char B2btype1path[256];
-        strcpy(B2btype1path, "D:\\B2bLIB\\testdata\\PrnMask20240824.dat");
-        FILE* B2btype1 = fopen(B2btype1path, "rb");
-        readB2bType1(B2btype1, &navs.b2bsat,&navs.b2bsat_pre,obs[0].time);
-
-        //read type 2
-        char B2btype2path[256];
-        strcpy(B2btype2path, "D:\\B2bLIB\\testdata\\OrbCorr20240824.dat");
-        FILE* B2btype2 = fopen(B2btype2path, "rb");
-        readB2bType2(B2btype2, &navs.b2bsat, obs[0].time);
-
-        //read type 3
-        char B2btype3path[256];
-        strcpy(B2btype3path, "D:\\B2bLIB\\testdata\\DcbCorr20240824.dat");
-        FILE* B2btype3 = fopen(B2btype3path, "rb");
-        readB2bType3(B2btype3, &navs.b2bsat, obs[0].time);
-
-        //read type 4
-        char B2btype4path[256];
-        strcpy(B2btype4path, "D:\\B2bLIB\\testdata\\ClkCorr20240824.dat");
-        FILE* B2btype4 = fopen(B2btype4path, "rb");
-        readB2bType4(B2btype4, &navs.b2bsat, obs[0].time);
-
-       
+        
+        /* slide RINEX 4 navigation window */
+        if (rnx4nav.n>0) {
+            slideRinex4Nav(&rnx4nav,&navs,obs[0].time);
+        }
+        /* update B2b corrections */
+        if (b2bhis.mask.n>0) {
+            inputB2bhis(&b2bhis,&navs,obs[0].time);
+        }
+        else {
+            inputB2breader(&b2breader,&navs,obs[0].time);
+            inputB2bmsg(&b2b,&ib2b,&navs,obs[0].time);
+        }
+        
         /* update sbas corrections */
         while (isbs<sbss.n) {
             time=gpst2time(sbss.msgs[isbs].week,sbss.msgs[isbs].tow);
@@ -328,6 +318,10 @@ static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
         for (i=0;i<nr&&n<MAXOBS*2;i++) obs[n++]=obss.data[iobsr-nr+1+i];
         iobsu-=nu;
         
+        /* update B2b corrections */
+        if (b2bhis.mask.n>0) {
+            inputB2bhis(&b2bhis,&navs,obs[0].time);
+        }
         /* update sbas corrections */
         while (isbs>=0) {
             time=gpst2time(sbss.msgs[isbs].week,sbss.msgs[isbs].tow);
@@ -583,6 +577,12 @@ static void readpreceph(char **infile, int n, const prcopt_t *prcopt,
         if (strstr(infile[i],"%r")||strstr(infile[i],"%b")) continue;
         sbsreadmsg(infile[i],prcopt->sbassatsel,sbs);
     }
+    /* read B2b message files */
+    b2b.n=b2b.nmax=0;
+    for (i=0;i<n;i++) {
+        if (strstr(infile[i],"%r")||strstr(infile[i],"%b")) continue;
+        readB2bmsg(infile[i],&b2b);
+    }
     /* allocate sbas ephemeris */
     nav->ns=nav->nsmax=NSATSBS*2;
     if (!(nav->seph=(seph_t *)malloc(sizeof(seph_t)*nav->ns))) {
@@ -615,6 +615,7 @@ static void freepreceph(nav_t *nav, sbs_t *sbs)
     free(nav->pclk); nav->pclk=NULL; nav->nc=nav->ncmax=0;
     free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;
     free(sbs->msgs); sbs->msgs=NULL; sbs->n =sbs->nmax =0;
+    free(b2b.msgs); b2b.msgs=NULL; b2b.n=b2b.nmax=0;
     for (i=0;i<nav->nt;i++) {
         free(nav->tec[i].data);
         free(nav->tec[i].rms );
@@ -691,6 +692,85 @@ static void freeobsnav(obs_t *obs, nav_t *nav)
     free(nav->eph ); nav->eph =NULL; nav->n =nav->nmax =0;
     free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;
     free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;
+    free(nav->ephidx); nav->ephidx=NULL; nav->nidx=0;
+    free(nav->meta); nav->meta=NULL;
+    
+    closeRinex4Nav(&rnx4nav);
+    closeB2breader(&b2breader);
+    freeB2bhis(&b2bhis);
+}
+/* read RINEX 4 navigation files ---------------------------------------------*/
+static int readrnx4nav(gtime_t ts, gtime_t te, const prcopt_t *popt,
+                       const filopt_t *fopt)
+{
+    const double tmax=MAXDTOE_CMP+1.0;
+    char *paths[MAXPRCDAYS];
+    int i,n,stat=0;
+    
+    trace(3,"readrnx4nav: ts=%s\n",time_str(ts,0));
+    
+    closeRinex4Nav(&rnx4nav);
+    
+    for (i=0;i<MAXPRCDAYS;i++) {
+        if (!(paths[i]=(char *)malloc(1024))) {
+            for (i--;i>=0;i--) free(paths[i]);
+            return 0;
+        }
+    }
+    /* expand keywords over the time span extended by max age of ephemeris */
+    if (ts.time&&te.time) {
+        n=reppaths(fopt->rnx4nav,paths,MAXPRCDAYS,timeadd(ts,-tmax),
+                   timeadd(te,tmax),"","");
+    }
+    else {
+        reppath(fopt->rnx4nav,paths[0],ts,"","");
+        n=1;
+    }
+    /* sliding window for forward processing */
+    if (popt->navslide&&ts.time&&
+        (popt->mode==PMODE_SINGLE||popt->soltype==0)) {
+        stat=openRinex4Nav(&rnx4nav,paths,n,ts,&navs)>0;
+    }
+    else {
+        for (i=0;i<n;i++) stat|=readRinex4Navt(paths[i],ts,te,&navs);
+    }
+    for (i=0;i<MAXPRCDAYS;i++) free(paths[i]);
+    
+    if (!stat) {
+        showmsg("error : RINEX 4 nav file %s",fopt->rnx4nav);
+        trace(2,"RINEX 4 nav file error: %s\n",fopt->rnx4nav);
+    }
+    return stat;
+}
+/* open B2b correction files -------------------------------------------------*/
+static void openb2b(gtime_t ts, const filopt_t *fopt)
+{
+    char path[4][1024],*files[4];
+    const char *file[]={fopt->b2bmask,fopt->b2borb,fopt->b2bdcb,fopt->b2bclk};
+    int i;
+    
+    trace(3,"openb2b :\n");
+    
+    closeB2breader(&b2breader);
+    
+    /* binary correction container precedes text correction files */
+    if (*fopt->b2bbin) {
+        reppath(fopt->b2bbin,path[0],ts,"","");
+        if (!openB2bbin(&b2breader,path[0],ts)) {
+            showmsg("error : B2b correction container %s",path[0]);
+            trace(2,"B2b correction container error: %s\n",path[0]);
+        }
+        return;
+    }
+    for (i=0;i<4;i++) {
+        files[i]=path[i];
+        reppath(file[i],path[i],ts,"","");
+    }
+    if (openB2breader(&b2breader,files,ts)<4) {
+        showmsg("warning : B2b correction file missing");
+        trace(2,"B2b correction file missing: %s %s %s %s\n",path[0],path[1],
+              path[2],path[3]);
+    }
 }
 /* average of single position ------------------------------------------------*/
 static int avepos(double *ra, int rcv, const obs_t *obs, const nav_t *nav,
@@ -972,6 +1052,10 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
             trace(2,"no erp data %s\n",path);
         }
     }
+    /* read RINEX 4 navigation data */
+    if (*fopt->rnx4nav) {
+        readrnx4nav(ts,te,&popt_,fopt);
+    }
     /* read obs and nav data */
     if (!readobsnav(ts,te,ti,infile,index,n,&popt_,&obss,&navs,stas)) return 0;
     
@@ -980,6 +1064,21 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         reppath(fopt->dcb,path,ts,"","");
         readdcb(path,&navs,stas);
     }
+    /* open B2b correction files */
+    if (popt_.sateph==EPHOPT_B2b) {
+        openb2b(ts,fopt);
+        
+        /* preload B2b correction history, required by backward/combined */
+        if (popt_.b2bload||(popt_.mode!=PMODE_SINGLE&&popt_.soltype!=0)) {
+            if (buildB2bhis(&b2bhis,&b2breader,&b2b)<0) {
+                showmsg("error : B2b correction history memory allocation");
+                freeB2bhis(&b2bhis);
+            }
+            closeB2breader(&b2breader);
+        }
+        /* orbit cache shared by sessions (initialized in postpos()) */
+        navs.b2bsat.cache=popt_.b2bcache?&b2bcache:NULL;
+    }
     /* set antenna paramters */
     if (popt_.mode!=PMODE_SINGLE) {
         setpcv(obss.n>0?obss.data[0].time:timeget(),&popt_,&navs,&pcvss,&pcvsr,
@@ -1224,6 +1323,9 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
     /* open processing session */
     if (!openses(popt,sopt,fopt,&navs,&pcvss,&pcvsr)) return -1;
     
+    /* B2b orbit cache kept over sessions */
+    if (popt->sateph==EPHOPT_B2b&&popt->b2bcache) initB2bcache(&b2bcache);
+    
     if (ts.time!=0&&te.time!=0&&tu>=0.0) {
         if (timediff(te,ts)<0.0) {
             showmsg("error : no period");
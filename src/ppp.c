@@ -70,6 +70,7 @@
 #define ROUND(x)    (int)floor((x)+0.5)
 
 #define MAX_ITER    8               /* max number of iterations */
+#define THRES_MDL_POS 0.1           /* position threshold to update models (m) */
 #define MAX_STD_FIX 0.15            /* max std-dev (3d) to fix solution */
 #define MIN_NSAT_SOL 4              /* min satellite number for solution */
 #define THRES_REJECT 6.0          /* reject threshold of posfit-res (sigma) */
@@ -335,14 +336,57 @@ static double varerr(int sat, int sys, double el, int idx, int type,
     if (opt->ionoopt==IONOOPT_IFLC) fact*=3.0;
     return SQR(fact*opt->err[1])+SQR(fact*opt->err[2]/sinel);
 }
-/* initialize state and covariance -------------------------------------------*/
+/* search active state index -------------------------------------------------*/
+static int findix(const rtk_t *rtk, int i, int *k)
+{
+    int lo=0,hi=rtk->nix-1,mid;
+    
+    while (lo<=hi) {
+        mid=(lo+hi)/2;
+        if (rtk->ix[mid]==i) {*k=mid; return 1;}
+        if (rtk->ix[mid]<i) lo=mid+1; else hi=mid-1;
+    }
+    *k=lo;
+    return 0;
+}
+/* initialize state and covariance ---------------------------------------------
+* the active states are kept as a sorted index list (rtk->ix). a state enters
+* the list with nonzero value and variance and leaves it on reset. covariances
+* between an active and an inactive state are always zero, so that only the
+* active entries of row/column i need to be cleared
+*-----------------------------------------------------------------------------*/
 static void initx(rtk_t *rtk, double xi, double var, int i)
 {
-    int j;
+    int j,k,act=findix(rtk,i,&k);
+    
     rtk->x[i]=xi;
-    for (j=0;j<rtk->nx;j++) {
-        rtk->P[i+j*rtk->nx]=rtk->P[j+i*rtk->nx]=i==j?var:0.0;
+    if (act) {
+        for (j=0;j<rtk->nix;j++) {
+            rtk->P[i+rtk->ix[j]*rtk->nx]=rtk->P[rtk->ix[j]+i*rtk->nx]=0.0;
+        }
+    }
+    rtk->P[i+i*rtk->nx]=var;
+    
+    if (xi!=0.0&&var>0.0) { /* allocate slot */
+        if (act) return;
+        memmove(rtk->ix+k+1,rtk->ix+k,sizeof(int)*(rtk->nix-k));
+        rtk->ix[k]=i; rtk->nix++;
+    }
+    else if (act) { /* release slot */
+        memmove(rtk->ix+k,rtk->ix+k+1,sizeof(int)*(rtk->nix-k-1));
+        rtk->nix--;
+    }
+}
+/* index of active states ----------------------------------------------------*/
+static int actstate(const rtk_t *rtk, int *ix)
+{
+    int i,j,n=0;
+    
+    for (i=0;i<rtk->nix;i++) {
+        j=rtk->ix[i];
+        if (rtk->x[j]!=0.0&&rtk->P[j+j*rtk->nx]>0.0) ix[n++]=j;
     }
+    return n;
 }
 /* geometry-free phase measurement -------------------------------------------*/
 static double gfmeas(const obsd_t *obs, const nav_t *nav)
@@ -392,8 +436,9 @@ static void corr_meas(const obsd_t *obs, const nav_t *nav, const double *azel,
                       double *Lc, double *Pc)
 {
    
-    double freq[NFREQ]={0};
-    int i,j,sys=satsys(obs->sat,NULL);
+    const satmeta_t *meta=nav->meta?nav->meta+obs->sat-1:NULL;
+    double freq[NFREQ]={0},lam;
+    int i,sys=meta?meta->sys:satsys(obs->sat,NULL);
     double aph,beta;
 
     for (i=0;i<NFREQ;i++) {
@@ -401,9 +446,11 @@ static void corr_meas(const obsd_t *obs, const nav_t *nav, const double *azel,
         freq[i]=sat2freq(obs->sat,obs->code[i],nav);
         if (freq[i]==0.0||obs->L[i]==0.0||obs->P[i]==0.0) continue;
         if (testsnr(0,0,azel[1],obs->SNR[i]*SNR_UNIT,&opt->snrmask)) continue;
+        lam=meta?meta->lam[obs->code[i]]:0.0;
+        if (lam<=0.0) lam=CLIGHT/freq[i];
         
         /* antenna phase center and phase windup correction */
-        L[i]=obs->L[i]*CLIGHT/freq[i]-dants[i]-dantr[i]-phw*CLIGHT/freq[i];
+        L[i]=obs->L[i]*lam-dants[i]-dantr[i]-phw*lam;
         P[i]=obs->P[i]-dants[i]-dantr[i];
         
         /* P1-C1,P2-C2 dcb correction (C1->P1,C2->P2) */
@@ -505,6 +552,7 @@ static void detslp_mw(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 /* temporal update of position -----------------------------------------------*/
 static void udpos_ppp(rtk_t *rtk)
 {
+    wsbuf_t *ws=&rtk->ws;
     double *F,*P,*FP,*x,*xp,pos[3],Q[9]={0},Qv[9];
     int i,j,*ix,nx;
     
@@ -538,16 +586,16 @@ static void udpos_ppp(rtk_t *rtk)
         return;
     }
     /* generate valid state index */
-    ix=imat(rtk->nx,1);
-    for (i=nx=0;i<rtk->nx;i++) {
-        if (rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0) ix[nx++]=i;
-    }
+    ix=wsimat(ws,rtk->nx,1);
+    nx=actstate(rtk,ix);
     if (nx<9) {
-        free(ix);
+        wsrelease(ws,ix);
         return;
     }
     /* state transition of position/velocity/acceleration */
-    F=eye(nx); P=mat(nx,nx); FP=mat(nx,nx); x=mat(nx,1); xp=mat(nx,1);
+    F=wszeros(ws,nx,nx); P=wsmat(ws,nx,nx); FP=wsmat(ws,nx,nx); x=wsmat(ws,nx,1);
+    xp=wsmat(ws,nx,1);
+    for (i=0;i<nx;i++) F[i+i*nx]=1.0;
     
     for (i=0;i<6;i++) {
         F[i+(i+3)*nx]=rtk->tt;
@@ -580,7 +628,8 @@ static void udpos_ppp(rtk_t *rtk)
     for (i=0;i<3;i++) for (j=0;j<3;j++) {
         rtk->P[i+6+(j+6)*rtk->nx]+=Qv[i+j*3];
     }
-    free(ix); free(F); free(P); free(FP); free(x); free(xp);
+    wsrelease(ws,xp); wsrelease(ws,x); wsrelease(ws,FP); wsrelease(ws,P);
+    wsrelease(ws,F); wsrelease(ws,ix);
 }
 /* temporal update of clock --------------------------------------------------*/
 static void udclk_ppp(rtk_t *rtk)
@@ -645,7 +694,7 @@ static void udiono_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     for (i=0;i<MAXSAT;i++) {
         j=II(i+1,&rtk->opt);
         if (rtk->x[j]!=0.0&&(int)rtk->ssat[i].outc[0]>gap_resion) {
-            rtk->x[j]=0.0;
+            initx(rtk,0.0,0.0,j);
         }
     }
     for (i=0;i<n;i++) {
@@ -892,21 +941,75 @@ static int model_iono(gtime_t time, const double *pos, const double *azel,
     }
     return 0;
 }
-/* phase and code residuals --------------------------------------------------*/
+/* state-independent observation models --------------------------------------*/
+static int model_obs(const obsd_t *obs, const double *rs, const double *rr,
+                     const double *pos, const double *azel, const nav_t *nav,
+                     rtk_t *rtk, pppmdl_t *mdl)
+{
+    prcopt_t *opt=&rtk->opt;
+    const double zazel[]={0.0,PI/2.0};
+    double dantr[NFREQ]={0},dants[NFREQ]={0},cotz;
+    int sat=obs->sat;
+    
+    /* tropospheric model (zhd and mapping functions if estimated) */
+    if (opt->tropopt==TROPOPT_EST||opt->tropopt==TROPOPT_ESTG) {
+        mdl->trp[0]=tropmodel(obs->time,pos,zazel,0.0);
+        mdl->trp[1]=tropmapf(obs->time,pos,azel,mdl->trp+2);
+        mdl->trp[3]=mdl->trp[4]=0.0;
+        if (azel[1]>0.0) {
+            cotz=1.0/tan(azel[1]);
+            mdl->trp[3]=mdl->trp[2]*cotz*cos(azel[0]);
+            mdl->trp[4]=mdl->trp[2]*cotz*sin(azel[0]);
+        }
+    }
+    else if (!model_trop(obs->time,pos,azel,opt,NULL,NULL,nav,mdl->trp,
+                         mdl->trp+1)) {
+        return 0;
+    }
+    /* ionospheric model (if not estimated) */
+    mdl->ion[0]=mdl->ion[1]=0.0;
+    if (opt->ionoopt!=IONOOPT_EST&&
+        !model_iono(obs->time,pos,azel,opt,sat,NULL,nav,mdl->ion,mdl->ion+1)) {
+        return 0;
+    }
+    /* satellite and receiver antenna model */
+    if (opt->posopt[0]) satantpcv(rs,rr,nav->pcvs+sat-1,dants);
+    antmodel(opt->pcvr,opt->antdel[0],azel,opt->posopt[1],dantr);
+    
+    /* phase windup model */
+    if (!model_phw(rtk->sol.time,sat,nav->pcvs[sat-1].type,
+                   opt->posopt[2]?2:0,rs,rr,&rtk->ssat[sat-1].phw)) {
+        return 0;
+    }
+    /* corrected phase and code measurements */
+    corr_meas(obs,nav,azel,opt,dantr,dants,rtk->ssat[sat-1].phw,mdl->L,mdl->P,
+              &mdl->Lc,&mdl->Pc);
+    return 1;
+}
+/* set design matrix of active state -----------------------------------------*/
+static void seth(double *H, const int *ic, int nc, int nv, int i, double a)
+{
+    if (ic[i]>=0) H[ic[i]+nc*nv]=a;
+}
+/* phase and code residuals ----------------------------------------------------
+* H is built over the nc active states, ic maps a state index to the row of H
+* (-1: inactive). R returns the variances of the residuals (nv x 1), as the
+* measurement errors are uncorrelated
+*-----------------------------------------------------------------------------*/
 static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                    const double *dts, const double *var_rs, const int *svh,
                    const double *dr, int *exc, const nav_t *nav,
-                   const double *x, rtk_t *rtk, double *v, double *H, double *R,
-                   double *azel)
+                   const double *x, rtk_t *rtk, const int *ic, int nc,
+                   double *v, double *H, double *R, double *azel)
 {
     prcopt_t *opt=&rtk->opt;
-    double y,r,cdtr,bias,C=0.0,rr[3],pos[3],e[3],dtdx[3],L[NFREQ],P[NFREQ],Lc,Pc;
-    double var[MAXOBS*2],dtrp=0.0,dion=0.0,vart=0.0,vari=0.0,dcb,freq;
-    double dantr[NFREQ]={0},dants[NFREQ]={0};
+    pppmdl_t *mdl,mdl0;
+    double y,r,cdtr,bias,C=0.0,rr[3],pos[3],e[3],dtdx[3]={0},*L,*P,Lc,Pc;
+    double var[MAXOBS*2],dtrp=0.0,dion=0.0,dcb,freq,dz;
     double ve[MAXOBS*2*NFREQ]={0},vmax=0;
     char str[32];
     int ne=0,obsi[MAXOBS*2*NFREQ]={0},frqi[MAXOBS*2*NFREQ],maxobs,maxfrq,rej;
-    int i,j,k,sat,sys,nv=0,nx=rtk->nx,stat=1;
+    int i,j,k,sat,sys,nv=0,stat=1;
     
     time2str(obs[0].time,str,2);
    /* if (opt->tidecorr) {
@@ -917,6 +1020,14 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
     for (i=0;i<3;i++) rr[i]=x[i]+dr[i];
     ecef2pos(rr,pos);
     
+    /* invalidate cached models by new epoch or receiver position moved */
+    if (rtk->mdl&&(timediff(obs[0].time,rtk->tmdl)!=0.0||
+        SQR(rr[0]-rtk->rmdl[0])+SQR(rr[1]-rtk->rmdl[1])+
+        SQR(rr[2]-rtk->rmdl[2])>SQR(THRES_MDL_POS))) {
+        rtk->tmdl=obs[0].time;
+        matcpy(rtk->rmdl,rr,3,1);
+        for (i=0;i<MAXSAT;i++) rtk->mdl[i].stat=0;
+    }
     for (i=0;i<n&&i<MAXOBS;i++) {
         sat=obs[i].sat;
    
@@ -930,23 +1041,29 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
             exc[i]=1;
             continue;
         }
-        /* tropospheric and ionospheric model */
-        if (!model_trop(obs[i].time,pos,azel+i*2,opt,x,dtdx,nav,&dtrp,&vart)||
-            !model_iono(obs[i].time,pos,azel+i*2,opt,sat,x,nav,&dion,&vari)) {
-            continue;
+        /* state-independent models (cached over residual passes) */
+        mdl=rtk->mdl?rtk->mdl+sat-1:&mdl0;
+        if (!rtk->mdl||!mdl->stat) {
+            mdl->stat=model_obs(obs+i,rs+i*6,rr,pos,azel+i*2,nav,rtk,mdl)?1:-1;
         }
-        /* satellite and receiver antenna model */
-        if (opt->posopt[0]) satantpcv(rs+i*6,rr,nav->pcvs+sat-1,dants);
-        antmodel(opt->pcvr,opt->antdel[0],azel+i*2,opt->posopt[1],dantr);
+        if (mdl->stat<0) continue;
+        L=mdl->L; P=mdl->P; Lc=mdl->Lc; Pc=mdl->Pc;
         
-        /* phase windup model */
-        if (!model_phw(rtk->sol.time,sat,nav->pcvs[sat-1].type,
-                       opt->posopt[2]?2:0,rs+i*6,rr,&rtk->ssat[sat-1].phw)) {
-            continue;
+        /* tropospheric and ionospheric model */
+        if (opt->tropopt==TROPOPT_EST||opt->tropopt==TROPOPT_ESTG) {
+            j=IT(opt);
+            dz=x[j]-mdl->trp[0];
+            dtdx[0]=mdl->trp[2];
+            if (opt->tropopt==TROPOPT_ESTG) {
+                dtdx[0]+=mdl->trp[3]*x[j+1]+mdl->trp[4]*x[j+2];
+            }
+            dtdx[1]=mdl->trp[3]*dz;
+            dtdx[2]=mdl->trp[4]*dz;
+            dtrp=mdl->trp[1]*mdl->trp[0]+dtdx[0]*dz;
         }
-        /* corrected phase and code measurements */
-        corr_meas(obs+i,nav,azel+i*2,&rtk->opt,dantr,dants,
-                  rtk->ssat[sat-1].phw,L,P,&Lc,&Pc);
+        else dtrp=mdl->trp[0];
+        
+        dion=opt->ionoopt==IONOOPT_EST?x[II(sat,opt)]:mdl->ion[0];
         
         /* stack phase and code residuals {L1,P1,L2,P2,...} */
         for (j=0;j<2*NF(opt);j++) {
@@ -962,7 +1079,8 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                 if ((freq=sat2freq(sat,obs[i].code[j/2],nav))==0.0) continue;
                 C=SQR(FREQ1/freq)*ionmapf(pos,azel+i*2)*(j%2==0?-1.0:1.0);
             }
-            for (k=0;k<nx;k++) H[k+nx*nv]=k<3?-e[k]:0.0;
+            for (k=0;k<nc;k++) H[k+nc*nv]=0.0;
+            for (k=0;k<3;k++) seth(H,ic,nc,nv,k,-e[k]);
             
             /* receiver clock */
             switch (sys) {
@@ -973,25 +1091,25 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                 default:      k=0; break;
             }
             cdtr=x[IC(k,opt)];
-            H[IC(k,opt)+nx*nv]=1.0;
+            seth(H,ic,nc,nv,IC(k,opt),1.0);
             
             if (opt->tropopt==TROPOPT_EST||opt->tropopt==TROPOPT_ESTG) {
                 for (k=0;k<(opt->tropopt>=TROPOPT_ESTG?3:1);k++) {
-                    H[IT(opt)+k+nx*nv]=dtdx[k];
+                    seth(H,ic,nc,nv,IT(opt)+k,dtdx[k]);
                 }
             }
             if (opt->ionoopt==IONOOPT_EST) {
                 if (rtk->x[II(sat,opt)]==0.0) continue;
-                H[II(sat,opt)+nx*nv]=C;
+                seth(H,ic,nc,nv,II(sat,opt),C);
             }
             if (j/2==2&&j%2==1) { /* L5-receiver-dcb */
                 dcb+=rtk->x[ID(opt)];
-                H[ID(opt)+nx*nv]=1.0;
+                seth(H,ic,nc,nv,ID(opt),1.0);
             }
             if (j%2==0) { /* phase bias */
                 if ((bias=x[IB(sat,j/2,opt)])==0.0) continue;
 
-                H[IB(sat,j/2,opt)+nx*nv]=1.0;
+                seth(H,ic,nc,nv,IB(sat,j/2,opt),1.0);
             }
             /* residual */
             v[nv]=y-(r+cdtr-CLIGHT*dts[i*2]+dtrp+C*dion+dcb+bias);
@@ -1000,9 +1118,8 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
             else        rtk->ssat[sat-1].resp[j/2]=v[nv];
             
             /* variance */
-            //GCC Height-angle weighting only
-            var[nv] = varerr(obs[i].sat, sys, azel[1 + i * 2], j / 2, j % 2, opt);//+
-                //vart + SQR(C) * vari;//+var_rs[i];
+            /* elevation-dependent weighting only (model variances not added) */
+            var[nv] = varerr(obs[i].sat, sys, azel[1 + i * 2], j / 2, j % 2, opt);
             if (sys==SYS_GLO&&j%2==1) var[nv]+=VAR_GLO_IFB;
             
             trace(4,"%s sat=%2d %s%d res=%9.4f sig=%9.4f el=%4.1f\n",str,sat,
@@ -1038,9 +1155,8 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
         exc[maxobs]=1; rtk->ssat[sat-1].rejc[maxfrq%2]++; stat=0;
         ve[rej]=0;
     }
-    for (i=0;i<nv;i++) for (j=0;j<nv;j++) {
-        R[i+j*nv]=i==j?var[i]:0.0;
-    }
+    for (i=0;i<nv;i++) R[i]=var[i];
+    
     return post?stat:nv;
 }
 /* number of estimated states ------------------------------------------------*/
@@ -1122,15 +1238,19 @@ static int test_hold_amb(rtk_t *rtk)
 /* precise point positioning -------------------------------------------------*/
 extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 {
+    wsbuf_t *ws=&rtk->ws;
     const prcopt_t *opt=&rtk->opt;
-    double *rs,*dts,*var,*v,*H,*R,*azel,*xp,*Pp,dr[3]={0},std[3];
+    double *rs,*dts,*var,*v,*H,*R,*azel,*xp,*Pp,*xc,*Pc,dr[3]={0},std[3];
     char str[32];
-    int i,j,nv,info,svh[MAXOBS],exc[MAXOBS]={0},stat=SOLQ_SINGLE;
+    int i,j,k,nv,nc,info,*ix,*ic,svh[MAXOBS],exc[MAXOBS]={0},stat=SOLQ_SINGLE;
     
     time2str(obs[0].time,str,2);
     trace(3,"pppos   : time=%s nx=%d n=%d\n",str,rtk->nx,n);
     
-    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); azel=zeros(2,n);
+    /* grow workspace arena to peak usage of previous epochs */
+    wsreserve(ws);
+    
+    rs=wsmat(ws,6,n); dts=wsmat(ws,2,n); var=wsmat(ws,1,n); azel=wszeros(ws,2,n);
     
     for (i=0;i<MAXSAT;i++) for (j=0;j<opt->nf;j++) rtk->ssat[i].fix[j]=0;
     
@@ -1150,29 +1270,43 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
         tidedisp(gpst2utc(obs[0].time),rtk->x,opt->tidecorr==1?1:7,&nav->erp,
                  opt->odisp[0],dr);
     }
+    /* active states and their rows in compact states */
+    ix=wsimat(ws,rtk->nx,1); ic=wsimat(ws,rtk->nx,1);
+    nc=actstate(rtk,ix);
+    for (i=0;i<rtk->nx;i++) ic[i]=-1;
+    for (i=0;i<nc;i++) ic[ix[i]]=i;
+    
     nv=n*rtk->opt.nf*2+MAXSAT+3;
-    xp=mat(rtk->nx,1); Pp=zeros(rtk->nx,rtk->nx);
-    v=mat(nv,1); H=mat(rtk->nx,nv); R=mat(nv,nv);
+    xp=wsmat(ws,rtk->nx,1); xc=wsmat(ws,nc,1); Pc=wsmat(ws,nc,nc);
+    v=wsmat(ws,nv,1); H=wsmat(ws,nc,nv); R=wsmat(ws,nv,1);
     
     for (i=0;i<MAX_ITER;i++) {
         
         matcpy(xp,rtk->x,rtk->nx,1);
-        matcpy(Pp,rtk->P,rtk->nx,rtk->nx);
-       
+        for (j=0;j<nc;j++) {
+            xc[j]=xp[ix[j]];
+            for (k=0;k<nc;k++) Pc[j+k*nc]=rtk->P[ix[j]+ix[k]*rtk->nx];
+        }
         /* prefit residuals */
-        if (!(nv=ppp_res(0,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel))) {
+        if (!(nv=ppp_res(0,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,ic,nc,v,H,R,
+                         azel))) {
             trace(2,"%s ppp (%d) no valid obs data\n",str,i+1);
             break;
         }
         /* measurement update of ekf states */
-        if ((info=filter(xp,Pp,H,v,R,rtk->nx,nv))) {
+        if ((info=filterws(ws,xc,Pc,H,v,R,1,nc,nv))) {
             trace(2,"%s ppp (%d) filter error info=%d\n",str,i+1,info);
             break;
         }
+        for (j=0;j<nc;j++) xp[ix[j]]=xc[j];
+        
         /* postfit residuals */
-        if (ppp_res(i+1,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel)) {
+        if (ppp_res(i+1,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,ic,nc,v,H,R,
+                    azel)) {
             matcpy(rtk->x,xp,rtk->nx,1);
-            matcpy(rtk->P,Pp,rtk->nx,rtk->nx);
+            for (j=0;j<nc;j++) for (k=0;k<nc;k++) {
+                rtk->P[ix[j]+ix[k]*rtk->nx]=Pc[j+k*nc];
+            }
             stat=SOLQ_PPP;
             break;
         }
@@ -1182,9 +1316,15 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     }
     if (stat==SOLQ_PPP) {
         
-        /* ambiguity resolution in ppp */
-        if (ppp_ar(rtk,obs,n,exc,nav,azel,xp,Pp)&&
-            ppp_res(9,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel)) {
+        /* ambiguity resolution in ppp (full covariance only for ar) */
+        Pp=NULL;
+        if (opt->modear!=ARMODE_OFF) {
+            Pp=wsmat(ws,rtk->nx,rtk->nx);
+            matcpy(Pp,rtk->P,rtk->nx,rtk->nx);
+        }
+        if (Pp&&ppp_ar(rtk,obs,n,exc,nav,azel,xp,Pp)&&
+            ppp_res(9,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,ic,nc,v,H,R,
+                    azel)) {
             
             matcpy(rtk->xa,xp,rtk->nx,1);
             matcpy(rtk->Pa,Pp,rtk->nx,rtk->nx);
@@ -1205,7 +1345,9 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
             trace(2,"%s hold ambiguity\n",str);
             rtk->nfix=0;
         }
+        wsrelease(ws,Pp);
     }
-    free(rs); free(dts); free(var); free(azel);
-    free(xp); free(Pp); free(v); free(H); free(R);
+    wsrelease(ws,R); wsrelease(ws,H); wsrelease(ws,v); wsrelease(ws,Pc);
+    wsrelease(ws,xc); wsrelease(ws,xp); wsrelease(ws,ic); wsrelease(ws,ix);
+    wsrelease(ws,azel); wsrelease(ws,var); wsrelease(ws,dts); wsrelease(ws,rs);
 }
@@ -30,7 +30,7 @@ static const char *help[]={
 "",
 " usage: rnx2rtkp [option]... file file [...]",
 "",
-" Read RINEX OBS/NAV/GNAV/HNAV/CLK, SP3, SBAS message log files and ccompute ",
+" Read RINEX OBS/NAV/GNAV/HNAV/CLK, SP3, SBAS/B2b message log files and ccompute ",
 " receiver (rover) positions and output position solutions.",
 " The first RINEX OBS file shall contain receiver (rover) observations. For the",
 " relative mode, the second RINEX OBS file shall contain reference",
@@ -72,7 +72,9 @@ static const char *help[]={
 " -l lat lon hgt reference (base) receiver latitude/longitude/height (deg/m)",
 "           rover latitude/longitude/height for fixed or ppp-fixed mode",
 " -y level  output soltion status (0:off,1:states,2:residuals) [0]",
-" -x level  debug trace level (0:off) [0]"
+" -x level  debug trace level (0:off) [0]",
+" -b2b file convert B2b correction files (file-b2b*file in configuration file)",
+"           to binary correction container file and exit [off]"
 };
 /* show message --------------------------------------------------------------*/
 extern int showmsg(const char *format, ...)
@@ -103,7 +105,7 @@ int main(int argc, char **argv)
     gtime_t ts={0},te={0};
     double tint=0.0,es[]={2000,1,1,0,0,0},ee[]={2000,12,31,23,59,59},pos[3];
     int i,j,n,ret;
-    char *infile[MAXFILE],*outfile="",*p, rinex4NavfilePath[256];
+    char *infile[MAXFILE],*outfile="",*b2bfile="",*p;
     
     prcopt.mode  =PMODE_KINEMA;
     prcopt.navsys=0;
@@ -113,14 +115,6 @@ int main(int argc, char **argv)
     sprintf(solopt.prog ,"%s ver.%s %s",PROGNAME,VER_RTKLIB,PATCH_LEVEL);
     sprintf(filopt.trace,"%s.trace",PROGNAME);
     
-     //GCC Set RINEX 4.0 broadcast ephemeris file path
-     strcpy(rinex4NavfilePath, "../../testdata/brd42370.24p");
-     //GCC Read the RINEX 4.0 broadcast ephemeris
-     if (!readRinex4Nav(rinex4NavfilePath, &navs))
-     {
-      fprintf(stderr, "READ Rinex4nav Ephemeris ERROR\n"); fflush(stderr);
-     }
-
     /* Load options from configuration file */
     for (i=1;i<argc;i++) {
         if (!strcmp(argv[i],"-k")&&i+1<argc) {
@@ -188,6 +182,7 @@ int main(int argc, char **argv)
         }
         else if (!strcmp(argv[i],"-y")&&i+1<argc) solopt.sstat=atoi(argv[++i]);
         else if (!strcmp(argv[i],"-x")&&i+1<argc) solopt.trace=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-b2b")&&i+1<argc) b2bfile=argv[++i];
         else if (*argv[i]=='-') printhelp();
         else if (n<MAXFILE) infile[n++]=argv[i];
     }
@@ -195,6 +190,15 @@ int main(int argc, char **argv)
     if (!prcopt.navsys) {
         prcopt.navsys=SYS_GPS|SYS_GLO;
     }
+    // Convert B2b correction files to binary correction container
+    if (*b2bfile) {
+        char *files[]={filopt.b2bmask,filopt.b2borb,filopt.b2bdcb,filopt.b2bclk};
+        if (!convB2bbin(files,b2bfile)) {
+            showmsg("error : B2b correction container conversion");
+            return -1;
+        }
+        return 0;
+    }
     if (n<=0) {
         showmsg("error : no input file");
         return -2;
@@ -11,6 +11,7 @@
 *           -DIERS_MODEL use GMF instead of NMF
 *           -DDLL      built for shared library
 *           -DCPUTIME_IN_GPST cputime operated in gpst
+*           -DKF_JOSEPH use Joseph form for covariance update of filter()
 *
 * references :
 *     [1] IS-GPS-200D, Navstar GPS Space Segment/Navigation User Interfaces,
@@ -147,6 +148,7 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <errno.h>
+#include <assert.h>
 #ifndef WIN32
 #include <dirent.h>
 #include <time.h>
@@ -247,6 +249,7 @@ const char *formatstrs[32]={    /* stream format strings */
     "RINEX CLK",                /* 15 */
     "SBAS",                     /* 16 */
     "NMEA 0183",                /* 17 */
+    "B2b",                      /* 18 */
     NULL
 };
 static char *obscodes[]={       /* observation code strings */
@@ -752,6 +755,11 @@ extern double sat2freq(int sat, uint8_t code, const nav_t *nav)
 {
     int i,fcn=0,sys,prn;
     
+    /* satellite metadata table (GLONASS of unknown FCN by ephemerides) */
+    if (nav&&nav->meta&&0<sat&&sat<=MAXSAT&&code<=MAXCODE&&
+        nav->meta[sat-1].fcn!=-99) {
+        return nav->meta[sat-1].freq[code];
+    }
     sys=satsys(sat,&prn);
     
     if (sys==SYS_GLO) {
@@ -1016,6 +1024,152 @@ extern double *eye(int n)
     if ((p=zeros(n,n))) for (i=0;i<n;i++) p[i+i*n]=1.0;
     return p;
 }
+/* initialize workspace arena --------------------------------------------------
+* initialize workspace arena for matrices used in an epoch
+* args   : wsbuf_t *ws      IO  workspace arena
+*          int    size      I   initial size of arena (doubles)
+* return : none
+* notes  : matrices are carved from the arena by wsmat(), wsimat() or wszeros()
+*          and returned by wsrelease(). if a matrix does not fit in the arena,
+*          it is allocated in heap (overflow). the arena is grown to the peak
+*          usage by wsreserve(), which is called with no matrix outstanding
+*          (at the start of an epoch), so the matrices are never moved.
+*          the arena may start empty (size=0) and be sized by the first epoch
+*-----------------------------------------------------------------------------*/
+extern void wsinit(wsbuf_t *ws, int size)
+{
+    ws->buff=NULL;
+    ws->size=ws->top=ws->peak=ws->nalloc=ws->nover=ws->nheap=0;
+    if (size<=0) return;
+    if (!(ws->buff=(double *)malloc(sizeof(double)*size))) {
+        fatalerr("workspace memory allocation error: size=%d\n",size);
+    }
+    ws->size=size;
+    ws->nalloc++;
+}
+/* free workspace arena --------------------------------------------------------
+* free workspace arena
+* args   : wsbuf_t *ws      IO  workspace arena
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void wsfree(wsbuf_t *ws)
+{
+    trace(3,"wsfree  : size=%d peak=%d nalloc=%d nover=%d\n",ws->size,ws->peak,
+          ws->nalloc,ws->nover);
+    
+    free(ws->buff); ws->buff=NULL;
+    ws->size=ws->top=0;
+}
+/* reserve workspace arena -----------------------------------------------------
+* grow workspace arena to the peak usage
+* args   : wsbuf_t *ws      IO  workspace arena
+* return : none
+* notes  : no operation if any matrix is outstanding
+*-----------------------------------------------------------------------------*/
+extern void wsreserve(wsbuf_t *ws)
+{
+    double *p;
+    
+    if (ws->top>0||ws->peak<=ws->size) return;
+    
+    if (!(p=(double *)malloc(sizeof(double)*ws->peak))) {
+        fatalerr("workspace memory allocation error: size=%d\n",ws->peak);
+    }
+    free(ws->buff);
+    ws->buff=p;
+    ws->size=ws->peak;
+    ws->nalloc++;
+    
+    trace(3,"wsreserve: size=%d nalloc=%d\n",ws->size,ws->nalloc);
+}
+/* new matrix in workspace arena -----------------------------------------------
+* carve matrix from workspace arena
+* args   : wsbuf_t *ws      IO  workspace arena (NULL: heap)
+*          int    n,m       I   number of rows and columns of matrix
+* return : matrix pointer (if n<=0 or m<=0, return NULL)
+*-----------------------------------------------------------------------------*/
+extern double *wsmat(wsbuf_t *ws, int n, int m)
+{
+    double *p;
+    
+    if (!ws) return mat(n,m);
+    if (n<=0||m<=0) return NULL;
+    
+    if (ws->top+n*m>ws->peak) ws->peak=ws->top+n*m;
+    
+    if (ws->top+n*m>ws->size) { /* overflow to heap */
+        ws->nover++;
+        ws->nheap++;
+        return mat(n,m);
+    }
+    p=ws->buff+ws->top;
+    ws->top+=n*m;
+    return p;
+}
+/* new integer matrix in workspace arena ---------------------------------------
+* carve integer matrix from workspace arena
+* args   : wsbuf_t *ws      IO  workspace arena (NULL: heap)
+*          int    n,m       I   number of rows and columns of matrix
+* return : matrix pointer (if n<=0 or m<=0, return NULL)
+*-----------------------------------------------------------------------------*/
+extern int *wsimat(wsbuf_t *ws, int n, int m)
+{
+    int k=(int)((sizeof(int)*n*m+sizeof(double)-1)/sizeof(double));
+    
+    if (!ws) return imat(n,m);
+    if (n<=0||m<=0) return NULL;
+    
+    if (ws->top+k>ws->peak) ws->peak=ws->top+k;
+    
+    if (ws->top+k>ws->size) { /* overflow to heap */
+        ws->nover++;
+        ws->nheap++;
+        return imat(n,m);
+    }
+    ws->top+=k;
+    return (int *)(ws->buff+ws->top-k);
+}
+/* zero matrix in workspace arena ----------------------------------------------
+* carve zero matrix from workspace arena
+* args   : wsbuf_t *ws      IO  workspace arena (NULL: heap)
+*          int    n,m       I   number of rows and columns of matrix
+* return : matrix pointer (if n<=0 or m<=0, return NULL)
+*-----------------------------------------------------------------------------*/
+extern double *wszeros(wsbuf_t *ws, int n, int m)
+{
+    double *p;
+    
+    if (!ws) return zeros(n,m);
+    if ((p=wsmat(ws,n,m))) for (n=n*m-1;n>=0;n--) p[n]=0.0;
+    return p;
+}
+/* release matrix in workspace arena -------------------------------------------
+* release matrix carved from workspace arena
+* args   : wsbuf_t *ws      IO  workspace arena (NULL: heap)
+*          void   *p        I   matrix pointer
+* return : none
+* notes  : the arena is released down to p, so p and all matrices carved after
+*          p must be no longer used. matrices are released in reverse order
+*          of carving (checked by assert() unless NDEBUG), and a matrix out of
+*          the arena must be an overflow to heap of the arena
+*-----------------------------------------------------------------------------*/
+extern void wsrelease(wsbuf_t *ws, void *p)
+{
+    double *q=(double *)p;
+    
+    if (!p) return;
+    
+    if (ws&&ws->buff&&q>=ws->buff&&q<ws->buff+ws->size) {
+        assert(q<ws->buff+ws->top); /* released twice or not in lifo order */
+        if (ws->top>(int)(q-ws->buff)) ws->top=(int)(q-ws->buff);
+        return;
+    }
+    if (ws) {
+        assert(ws->nheap>0); /* not carved from the arena */
+        ws->nheap--;
+    }
+    free(p);
+}
 /* inner product ---------------------------------------------------------------
 * inner product of vectors
 * args   : double *a,*b     I   vector a,b (n x 1)
@@ -1268,6 +1422,31 @@ extern int lsq(const double *A, const double *y, int n, int m, double *x,
     free(Ay);
     return info;
 }
+/* cholesky decomposition ------------------------------------------------------
+* cholesky decomposition of symmetric positive definite matrix: A=L*L'
+* args   : double *A        IO  matrix (m x m)
+*                               (I: lower triangle of A, O: L)
+*          int    m         I   size of matrix
+* return : status (0:ok,-1:not positive definite)
+* notes  : upper triangle of A is not referenced
+*-----------------------------------------------------------------------------*/
+static int cholesky(double *A, int m)
+{
+    double a,*Aj,*Ak;
+    int i,j,k;
+    
+    for (j=0;j<m;j++) {
+        Aj=A+j*m;
+        for (k=0;k<j;k++) { /* left-looking update of column j */
+            Ak=A+k*m; a=Ak[j];
+            for (i=j;i<m;i++) Aj[i]-=Ak[i]*a;
+        }
+        if (Aj[j]<=0.0) return -1;
+        a=sqrt(Aj[j]);
+        for (i=j;i<m;i++) Aj[i]/=a;
+    }
+    return 0;
+}
 /* kalman filter ---------------------------------------------------------------
 * kalman filter state update as follows:
 *
@@ -1278,52 +1457,166 @@ extern int lsq(const double *A, const double *y, int n, int m, double *x,
 *          double *H        I   transpose of design matrix (n x m)
 *          double *v        I   innovation (measurement - model) (m x 1)
 *          double *R        I   covariance matrix of measurement error (m x m)
+*                               (diag: variances of measurement error (m x 1))
+*          int    diag      I   diagonal measurement error covariance (0:off,1:on)
 *          int    n,m       I   number of states and measurements
 *          double *xp       O   states vector after update (n x 1)
 *          double *Pp       O   covariance matrix of states after update (n x n)
 * return : status (0:ok,<0:error)
 * notes  : matirix stored by column-major order (fortran convention)
 *          if state x[i]==0.0, not updates state x[i]/P[i+i*n]
+*          if all states are active, x/P/H are used without being gathered
+*          with Q=H'*P*H+R=L*L' (cholesky) and Z=P*H*L'^-1, the update is
+*          computed as xp=x+Z*(L^-1*v) and Pp=P-Z*Z' (upper triangle only)
+*          with -DKF_JOSEPH, Pp=(I-K*H')*P*(I-K*H')'+K*R*K' instead
+*          if error, xp=x and Pp=P
 *-----------------------------------------------------------------------------*/
-static int filter_(const double *x, const double *P, const double *H,
-                   const double *v, const double *R, int n, int m,
-                   double *xp, double *Pp)
+static int filter_(wsbuf_t *ws, const double *x, const double *P,
+                   const double *H, const double *v, const double *R, int diag,
+                   int n, int m, double *xp, double *Pp)
 {
-    double *F=mat(n,m),*Q=mat(m,m),*K=mat(n,m),*I=eye(n);
-    int info;
+    double *F=wsmat(ws,n,m),*Q=wsmat(ws,m,m),*w=wsmat(ws,m,1),a,*Fk,*Fj;
+    int i,j,k;
+#ifdef KF_JOSEPH
+    double *K,*G;
+#endif
     
-    matcpy(Q,R,m,m);
     matcpy(xp,x,n,1);
-    matmul("NN",n,m,n,1.0,P,H,0.0,F);       /* Q=H'*P*H+R */
-    matmul("TN",m,m,n,1.0,H,F,1.0,Q);
-    if (!(info=matinv(Q,m))) {
-        matmul("NN",n,m,m,1.0,F,Q,0.0,K);   /* K=P*H*Q^-1 */
-        matmul("NN",n,1,m,1.0,K,v,1.0,xp);  /* xp=x+K*v */
-        matmul("NT",n,n,m,-1.0,K,H,1.0,I);  /* Pp=(I-K*H')*P */
-        matmul("NN",n,n,n,1.0,I,P,0.0,Pp);
-    }
-    free(F); free(Q); free(K); free(I);
-    return info;
+    matcpy(Pp,P,n,n);
+    matmul("NN",n,m,n,1.0,P,H,0.0,F);       /* F=P*H */
+    
+    /* Q=H'*F+R (lower triangle) */
+    for (j=0;j<m;j++) for (i=j;i<m;i++) {
+        a=diag?(i==j?R[i]:0.0):R[i+j*m];
+        for (k=0;k<n;k++) a+=H[k+i*n]*F[k+j*n];
+        Q[i+j*m]=a;
+    }
+    if (cholesky(Q,m)) {
+        wsrelease(ws,w); wsrelease(ws,Q); wsrelease(ws,F);
+        return -1;
+    }
+    /* Z=F*L'^-1 (overwrite F) and w=L^-1*v */
+    for (k=0;k<m;k++) {
+        Fk=F+k*n;
+        a=v[k];
+        for (j=0;j<k;j++) {
+            Fj=F+j*n;
+            for (i=0;i<n;i++) Fk[i]-=Fj[i]*Q[k+j*m];
+            a-=Q[k+j*m]*w[j];
+        }
+        for (i=0;i<n;i++) Fk[i]/=Q[k+k*m];
+        w[k]=a/Q[k+k*m];
+    }
+    matmul("NN",n,1,m,1.0,F,w,1.0,xp);      /* xp=x+Z*w */
+    
+#ifndef KF_JOSEPH
+    /* Pp=P-Z*Z' (upper triangle) */
+    for (k=0;k<m;k++) {
+        Fk=F+k*n;
+        for (j=0;j<n;j++) {
+            if ((a=Fk[j])==0.0) continue;
+            for (i=0;i<=j;i++) Pp[i+j*n]-=Fk[i]*a;
+        }
+    }
+#else
+    K=wsmat(ws,n,m); G=wsmat(ws,n,m);
+    
+    /* K=Z*L^-1 */
+    for (k=m-1;k>=0;k--) {
+        for (i=0;i<n;i++) K[i+k*n]=F[i+k*n];
+        for (j=k+1;j<m;j++) for (i=0;i<n;i++) {
+            K[i+k*n]-=K[i+j*n]*Q[j+k*m];
+        }
+        for (i=0;i<n;i++) K[i+k*n]/=Q[k+k*m];
+    }
+    /* M=(I-K*H')*P=P-Z*Z', Pp=M*(I-K*H')'+K*R*K'=M+(K*R-M*H)*K' */
+    matmul("NT",n,n,m,-1.0,F,F,1.0,Pp);
+    matmul("NN",n,m,n,1.0,Pp,H,0.0,G);
+    if (diag) {
+        for (k=0;k<m;k++) for (i=0;i<n;i++) {
+            G[i+k*n]=K[i+k*n]*R[k]-G[i+k*n];
+        }
+    }
+    else matmul("NN",n,m,m,1.0,K,R,-1.0,G);
+    matmul("NT",n,n,m,1.0,G,K,1.0,Pp);
+    
+    /* symmetrize (upper triangle) */
+    for (j=0;j<n;j++) for (i=0;i<j;i++) {
+        Pp[i+j*n]=0.5*(Pp[i+j*n]+Pp[j+i*n]);
+    }
+    wsrelease(ws,G); wsrelease(ws,K);
+#endif
+    for (j=0;j<n;j++) for (i=j+1;i<n;i++) {
+        Pp[i+j*n]=Pp[j+i*n];
+    }
+    wsrelease(ws,w); wsrelease(ws,Q); wsrelease(ws,F);
+    return 0;
 }
 extern int filter(double *x, double *P, const double *H, const double *v,
                   const double *R, int n, int m)
+{
+    return filterws(NULL,x,P,H,v,R,0,n,m);
+}
+/* kalman filter with diagonal measurement error covariance --------------------
+* kalman filter state update with uncorrelated measurement errors. same as
+* filter() with R=diag(var)
+* args   : double *x        IO  states vector (n x 1)
+*          double *P        IO  covariance matrix of states (n x n)
+*          double *H        I   transpose of design matrix (n x m)
+*          double *v        I   innovation (measurement - model) (m x 1)
+*          double *var      I   variances of measurement error (m x 1)
+*          int    n,m       I   number of states and measurements
+* return : status (0:ok,<0:error)
+*-----------------------------------------------------------------------------*/
+extern int filterdiag(double *x, double *P, const double *H, const double *v,
+                      const double *var, int n, int m)
+{
+    return filterws(NULL,x,P,H,v,var,1,n,m);
+}
+/* kalman filter with workspace arena ------------------------------------------
+* kalman filter state update with matrices carved from workspace arena
+* args   : wsbuf_t *ws      IO  workspace arena (NULL: heap)
+*          double *x        IO  states vector (n x 1)
+*          double *P        IO  covariance matrix of states (n x n)
+*          double *H        I   transpose of design matrix (n x m)
+*          double *v        I   innovation (measurement - model) (m x 1)
+*          double *R        I   covariance matrix of measurement error (m x m)
+*                               (diag: variances of measurement error (m x 1))
+*          int    diag      I   diagonal measurement error covariance (0:off,1:on)
+*          int    n,m       I   number of states and measurements
+* return : status (0:ok,<0:error)
+*-----------------------------------------------------------------------------*/
+extern int filterws(wsbuf_t *ws, double *x, double *P, const double *H,
+                    const double *v, const double *R, int diag, int n, int m)
 {
     double *x_,*xp_,*P_,*Pp_,*H_;
     int i,j,k,info,*ix;
     
-    ix=imat(n,1); for (i=k=0;i<n;i++) if (x[i]!=0.0&&P[i+i*n]>0.0) ix[k++]=i;
-    x_=mat(k,1); xp_=mat(k,1); P_=mat(k,k); Pp_=mat(k,k); H_=mat(k,m);
+    ix=wsimat(ws,n,1); for (i=k=0;i<n;i++) if (x[i]!=0.0&&P[i+i*n]>0.0) ix[k++]=i;
+    
+    /* all states active (compact states): no gather */
+    if (k==n) {
+        xp_=wsmat(ws,n,1); Pp_=wsmat(ws,n,n);
+        info=filter_(ws,x,P,H,v,R,diag,n,m,xp_,Pp_);
+        matcpy(x,xp_,n,1);
+        matcpy(P,Pp_,n,n);
+        wsrelease(ws,Pp_); wsrelease(ws,xp_); wsrelease(ws,ix);
+        return info;
+    }
+    x_=wsmat(ws,k,1); xp_=wsmat(ws,k,1); P_=wsmat(ws,k,k); Pp_=wsmat(ws,k,k);
+    H_=wsmat(ws,k,m);
     for (i=0;i<k;i++) {
         x_[i]=x[ix[i]];
         for (j=0;j<k;j++) P_[i+j*k]=P[ix[i]+ix[j]*n];
         for (j=0;j<m;j++) H_[i+j*k]=H[ix[i]+j*n];
     }
-    info=filter_(x_,P_,H_,v,R,k,m,xp_,Pp_);
+    info=filter_(ws,x_,P_,H_,v,R,diag,k,m,xp_,Pp_);
     for (i=0;i<k;i++) {
         x[ix[i]]=xp_[i];
         for (j=0;j<k;j++) P[ix[i]+ix[j]*n]=Pp_[i+j*k];
     }
-    free(ix); free(x_); free(xp_); free(P_); free(Pp_); free(H_);
+    wsrelease(ws,H_); wsrelease(ws,Pp_); wsrelease(ws,P_); wsrelease(ws,xp_);
+    wsrelease(ws,x_); wsrelease(ws,ix);
     return info;
 }
 /* smoother --------------------------------------------------------------------
@@ -2712,6 +3005,9 @@ static void uniqeph(nav_t *nav)
             nav->eph[i].iode!=nav->eph[j].iode) {
             nav->eph[++j]=nav->eph[i];
         }
+        else if (!nav->eph[i].rnx4) { /* duplicate also read by other source */
+            nav->eph[j].rnx4=0;
+        }
     }
     nav->n=j+1;
     
@@ -2815,6 +3111,145 @@ extern void uniqnav(nav_t *nav)
     uniqeph (nav);
     uniqgeph(nav);
     uniqseph(nav);
+    
+    /* index ephemeris for selection */
+    indexeph(nav);
+    
+    /* satellite metadata */
+    setsatmeta(nav);
+}
+/* compare ephemeris index ---------------------------------------------------*/
+typedef struct {        /* ephemeris index sort type */
+    int sat;            /* satellite number */
+    gtime_t toe;        /* toe */
+    int i;              /* index of ephemeris */
+} ephidx_t;
+
+static int cmpephidx(const void *p1, const void *p2)
+{
+    ephidx_t *q1=(ephidx_t *)p1,*q2=(ephidx_t *)p2;
+    double tt;
+    if (q1->sat!=q2->sat) return q1->sat-q2->sat;
+    if ((tt=timediff(q1->toe,q2->toe))!=0.0) return tt<0.0?-1:1;
+    return q1->i-q2->i;
+}
+/* index ephemerides -----------------------------------------------------------
+* index broadcast ephemerides by satellite and toe for ephemeris selection
+* args   : nav_t *nav    IO     navigation data
+* return : status (1:ok,0:memory allocation error)
+* notes  : the index is valid while the number of ephemerides is unchanged.
+*          call indexeph() again after ephemerides are modified in place
+*-----------------------------------------------------------------------------*/
+extern int indexeph(nav_t *nav)
+{
+    ephidx_t *idx;
+    int i,sat;
+    
+    trace(3,"indexeph: n=%d\n",nav->n);
+    
+    free(nav->ephidx); nav->ephidx=NULL; nav->nidx=0;
+    
+    if (nav->n<=0) return 1;
+    
+    if (!(idx=(ephidx_t *)malloc(sizeof(ephidx_t)*nav->n))||
+        !(nav->ephidx=(int *)malloc(sizeof(int)*nav->n))) {
+        trace(1,"indexeph malloc error n=%d\n",nav->n);
+        free(idx);
+        return 0;
+    }
+    for (i=0;i<nav->n;i++) {
+        idx[i].sat=nav->eph[i].sat;
+        idx[i].toe=nav->eph[i].toe;
+        idx[i].i=i;
+    }
+    qsort(idx,nav->n,sizeof(ephidx_t),cmpephidx);
+    
+    for (i=0,sat=1;i<nav->n;i++) {
+        for (;sat<=idx[i].sat&&sat<=MAXSAT;sat++) nav->ephsat[sat-1]=i;
+        nav->ephidx[i]=idx[i].i;
+    }
+    for (;sat<=MAXSAT+1;sat++) nav->ephsat[sat-1]=nav->n;
+    nav->nidx=nav->n;
+    free(idx);
+    return 1;
+}
+/* search indexed ephemerides --------------------------------------------------
+* search ephemerides of a satellite with toe within a time window
+* args   : nav_t  *nav   I      navigation data
+*          int    sat    I      satellite number
+*          gtime_t time  I      time (gpst)
+*          double tmax   I      max difference of toe to time (s)
+*          int    *n     O      number of ephemerides
+* return : indices of ephemerides in nav->eph sorted by toe (NULL: no index)
+*-----------------------------------------------------------------------------*/
+extern const int *searcheph(const nav_t *nav, int sat, gtime_t time, double tmax,
+                            int *n)
+{
+    const int *idx;
+    int lo,hi,mid,i0;
+    
+    *n=0;
+    if (!nav->ephidx||nav->nidx!=nav->n) return NULL;
+    if (sat<=0||sat>MAXSAT) return NULL;
+    
+    /* first ephemeris with toe>=time-tmax */
+    idx=nav->ephidx+nav->ephsat[sat-1];
+    for (lo=0,hi=nav->ephsat[sat]-nav->ephsat[sat-1];lo<hi;) {
+        mid=(lo+hi)/2;
+        if (timediff(nav->eph[idx[mid]].toe,time)<-tmax) lo=mid+1; else hi=mid;
+    }
+    /* first ephemeris with toe>time+tmax */
+    for (i0=lo,hi=nav->ephsat[sat]-nav->ephsat[sat-1];lo<hi;) {
+        mid=(lo+hi)/2;
+        if (timediff(nav->eph[idx[mid]].toe,time)<=tmax) lo=mid+1; else hi=mid;
+    }
+    *n=lo-i0;
+    return idx+i0;
+}
+/* set satellite metadata ------------------------------------------------------
+* set satellite metadata table (system, prn, GLONASS FCN and carrier frequency
+* and wave length by obs code) used by sat2freq() instead of code2freq_???()
+* args   : nav_t *nav    IO     navigation data
+* return : status (1:ok,0:memory allocation error)
+* notes  : GLONASS FCN is taken from nav->geph or nav->glo_fcn as sat2freq().
+*          call setsatmeta() again after nav->geph or nav->glo_fcn is modified.
+*          for GLONASS satellites of unknown FCN (-99), sat2freq() searches
+*          nav->geph and nav->glo_fcn on each call as without the table
+*-----------------------------------------------------------------------------*/
+extern int setsatmeta(nav_t *nav)
+{
+    satmeta_t *meta;
+    int i,j,sat,fcn;
+    
+    trace(3,"setsatmeta: ng=%d\n",nav->ng);
+    
+    if (!nav->meta&&!(nav->meta=(satmeta_t *)malloc(sizeof(satmeta_t)*MAXSAT))) {
+        trace(1,"setsatmeta malloc error\n");
+        return 0;
+    }
+    for (sat=1;sat<=MAXSAT;sat++) {
+        meta=nav->meta+sat-1;
+        meta->sys=satsys(sat,&meta->prn);
+        meta->fcn=meta->sys==SYS_GLO?-99:0;
+    }
+    for (i=0;i<MAXPRNGLO;i++) {
+        if (nav->glo_fcn[i]>0&&(sat=satno(SYS_GLO,i+1))) {
+            nav->meta[sat-1].fcn=nav->glo_fcn[i]-8;
+        }
+    }
+    for (i=nav->ng-1;i>=0;i--) { /* first ephemeris of satellite precedes */
+        if ((sat=nav->geph[i].sat)<=0||sat>MAXSAT) continue;
+        nav->meta[sat-1].fcn=nav->geph[i].frq;
+    }
+    for (sat=1;sat<=MAXSAT;sat++) {
+        meta=nav->meta+sat-1;
+        fcn=meta->fcn;
+        for (j=0;j<=MAXCODE;j++) {
+            meta->freq[j]=fcn==-99?0.0:code2freq(meta->sys,(uint8_t)j,fcn);
+            meta->lam [j]=meta->freq[j]>0.0?CLIGHT/meta->freq[j]:0.0;
+        }
+    }
+    return 1;
 }
 /* compare observation data -------------------------------------------------*/
 static int cmpobs(const void *p1, const void *p2)
@@ -3014,8 +3449,10 @@ extern void freeobs(obs_t *obs)
 *-----------------------------------------------------------------------------*/
 extern void freenav(nav_t *nav, int opt)
 {
-    if (opt&0x01) {free(nav->eph ); nav->eph =NULL; nav->n =nav->nmax =0;}
-    if (opt&0x02) {free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;}
+    if (opt&0x01) {free(nav->eph ); nav->eph =NULL; nav->n =nav->nmax =0;
+                   free(nav->ephidx); nav->ephidx=NULL; nav->nidx=0;}
+    if (opt&0x02) {free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;
+                   free(nav->meta); nav->meta=NULL;}
     if (opt&0x04) {free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;}
     if (opt&0x08) {free(nav->peph); nav->peph=NULL; nav->ne=nav->nemax=0;}
     if (opt&0x10) {free(nav->pclk); nav->pclk=NULL; nav->nc=nav->ncmax=0;}
@@ -13,6 +13,7 @@
 *           -DMAXOBS=n set max number of obs data in an epoch
 *           -DWIN32    use WIN32 API
 *           -DWIN_DLL  generate library as Windows DLL
+*           -DNOSIMD   disable simd (avx2) kernel of eph2posvels()
 *
 * version : $Revision:$ $Date:$
 * history : 2007/01/13 1.0  rtklib ver.1.0.0
@@ -465,6 +466,7 @@ extern "C" {
 #define STRFMT_RNXCLK 15                /* stream format: RINEX CLK */
 #define STRFMT_SBAS  16                 /* stream format: SBAS messages */
 #define STRFMT_NMEA  17                 /* stream format: NMEA 0183 */
+#define STRFMT_B2B   18                 /* stream format: B2b corrections */
 #define MAXRCVFMT    12                 /* max number of receiver format */
 
 #define STR_MODE_R  0x1                 /* stream mode: read */
@@ -629,6 +631,7 @@ typedef struct {        /* GPS/QZS/GAL broadcast ephemeris type */
     int Enmt;            //EPH navigation message type 1LNAV 2:CNAV 3:D1 4:D2 5:CNV1 6:CNV2 7:CNV3 8:SBAS     
     int Inmt;           //STO EOP ION navigation message type 1LNAV 2:CNVX(CNAV CNV123) 3:D1D2  4:SBAS
     double top;        /* top for CNAV RINEX4.0 */
+    int rnx4;           /* read by RINEX4.0 loader (0:other sources) */
 } eph_t;
 
 typedef struct {        /* GLONASS broadcast ephemeris type */
@@ -801,6 +804,14 @@ typedef struct {        /* SSR correction type */
     uint8_t update;     /* update flag (0:no update,1:update) */
 } ssr_t;
 
+typedef struct {        /* satellite metadata type */
+    int sys;            /* navigation system (SYS_NONE: invalid satellite) */
+    int prn;            /* satellite prn/slot number */
+    int fcn;            /* GLONASS frequency channel number (-99: unknown) */
+    double freq[MAXCODE+1]; /* carrier frequency by obs code (Hz) (0.0: none) */
+    double lam [MAXCODE+1]; /* carrier wave length by obs code (m) (0.0: none) */
+} satmeta_t;
+
 //GCC
 #include "./B2bMSG.h"
 
@@ -842,8 +853,12 @@ typedef struct {        /* navigation data type */
     ssr_t ssr[MAXSAT];  /* SSR corrections */
     //GCC
     int leaps;          /* leap seconds (s) */
-    b2bsat_t b2bsat;  /*B2b corrections*/
-    b2bsat_t b2bsat_pre;  /*B2b corrections*/
+    b2bsat_t b2bsat;    /* B2b corrections */
+    const b2bsat_t *b2bp; /* B2b corrections published by stream (NULL: b2bsat) */
+    int nidx;           /* number of indexed ephemerides (see indexeph()) */
+    int *ephidx;        /* ephemeris indices sorted by satellite and toe */
+    int ephsat[MAXSAT+1]; /* start of ephemerides of satellites in ephidx */
+    satmeta_t *meta;    /* satellite metadata table (NULL: none) (see setsatmeta()) */
 } nav_t;
 
 typedef struct {        /* station parameter type */
@@ -1041,6 +1056,9 @@ typedef struct {        /* processing options type */
     double odisp[2][6*11]; /* ocean tide loading parameters {rov,base} */
     int  freqopt;       /* disable L2-AR */
     char pppopt[256];   /* ppp option */
+    int  b2bload;       /* preload B2b corrections of session (0:off,1:on) */
+    int  b2bcache;      /* cache broadcast orbits of B2b (0:off,1:on) */
+    int  navslide;      /* sliding RINEX 4 navigation window (0:off,1:on) */
 } prcopt_t;
 
 typedef struct {        /* solution options type */
@@ -1078,6 +1096,12 @@ typedef struct {        /* file options type */
     char geexe  [MAXSTRPATH]; /* google earth exec file */
     char solstat[MAXSTRPATH]; /* solution statistics file */
     char trace  [MAXSTRPATH]; /* debug trace file */
+    char b2bmask[MAXSTRPATH]; /* B2b Type1 satellite mask file */
+    char b2borb [MAXSTRPATH]; /* B2b Type2 orbit correction file */
+    char b2bdcb [MAXSTRPATH]; /* B2b Type3 code bias file */
+    char b2bclk [MAXSTRPATH]; /* B2b Type4 clock correction file */
+    char b2bbin [MAXSTRPATH]; /* B2b binary correction container file */
+    char rnx4nav[MAXSTRPATH]; /* RINEX 4 navigation file */
 } filopt_t;
 
 typedef struct {        /* RINEX options type */
@@ -1152,6 +1176,22 @@ typedef struct {        /* ambiguity control type */
     char flags[MAXSAT]; /* fix flags */
 } ambc_t;
 
+typedef struct {        /* ppp observation model type */
+    int stat;           /* model status (0:not computed,1:valid,-1:invalid) */
+    double trp[5];      /* troposphere {zhd,m_h,m_w,grad_n,grad_e} (estimated) */
+                        /* or {delay,variance} (m|m^2) */
+    double ion[2];      /* ionosphere {delay,variance} (not estimated) (m|m^2) */
+    double L[NFREQ],P[NFREQ]; /* corrected phase and code (m) */
+    double Lc,Pc;       /* ionosphere-free phase and code (m) */
+} pppmdl_t;
+
+typedef struct {        /* workspace arena type */
+    double *buff;       /* arena buffer */
+    int size,top,peak;  /* size/top/peak usage of arena (doubles) */
+    int nalloc,nover;   /* number of arena allocations/overflows to heap */
+    int nheap;          /* number of outstanding overflows to heap */
+} wsbuf_t;
+
 typedef struct {        /* RTK control/result type */
     sol_t  sol;         /* RTK solution */
     double rb[6];       /* base position/velocity (ecef) (m|m/s) */
@@ -1159,12 +1199,17 @@ typedef struct {        /* RTK control/result type */
     double tt;          /* time difference between current and previous (s) */
     double *x, *P;      /* float states and their covariance */
     double *xa,*Pa;     /* fixed states and their covariance */
+    int nix,*ix;        /* number/index of active float states (ppp) */
+    gtime_t tmdl;       /* time of cached observation models (ppp) */
+    double rmdl[3];     /* receiver position of cached models (ecef) (m) */
+    pppmdl_t *mdl;      /* cached observation models by satellite (ppp) */
     int nfix;           /* number of continuous fixes of ambiguity */
     ambc_t ambc[MAXSAT]; /* ambibuity control */
     ssat_t ssat[MAXSAT]; /* satellite status */
     int neb;            /* bytes in error message buffer */
     char errbuf[MAXERRMSG]; /* error message buffer */
     prcopt_t opt;       /* processing options */
+    wsbuf_t ws;         /* workspace arena of epoch matrices */
 } rtk_t;
 
 typedef struct {        /* receiver raw data control type */
@@ -1274,6 +1319,12 @@ typedef struct {        /* RTK server type */
     obs_t obs[3][MAXOBSBUF]; /* observation data {rov,base,corr} */
     nav_t nav;          /* navigation data */
     sbsmsg_t sbsmsg[MAXSBSMSG]; /* SBAS message buffer */
+    b2bstr_t b2bstr[3]; /* B2b correction stream decoders {rov,base,corr} */
+    b2bdup_t b2bdup;    /* B2b duplicate frame filter of streams */
+    b2bsat_t *b2bbuf;   /* B2b correction buffers (3) (see rtksvr.c) */
+    int b2bw,b2br;      /* B2b buffer index of decoder/positioning */
+    volatile int b2bpub; /* B2b buffer index of published (+4: not taken) */
+    thread_t b2bthread; /* B2b correction decoder thread */
     stream_t stream[8]; /* streams {rov,base,corr,sol1,sol2,logr,logb,logc} */
     stream_t *moni;     /* monitor stream */
     uint32_t tick;      /* start tick */
@@ -1349,6 +1400,13 @@ EXPORT double *mat  (int n, int m);
 EXPORT int    *imat (int n, int m);
 EXPORT double *zeros(int n, int m);
 EXPORT double *eye  (int n);
+EXPORT void    wsinit   (wsbuf_t *ws, int size);
+EXPORT void    wsfree   (wsbuf_t *ws);
+EXPORT void    wsreserve(wsbuf_t *ws);
+EXPORT double *wsmat    (wsbuf_t *ws, int n, int m);
+EXPORT int    *wsimat   (wsbuf_t *ws, int n, int m);
+EXPORT double *wszeros  (wsbuf_t *ws, int n, int m);
+EXPORT void    wsrelease(wsbuf_t *ws, void *p);
 EXPORT double dot (const double *a, const double *b, int n);
 EXPORT double norm(const double *a, int n);
 EXPORT void cross3(const double *a, const double *b, double *c);
@@ -1363,6 +1421,10 @@ EXPORT int  lsq   (const double *A, const double *y, int n, int m, double *x,
                    double *Q);
 EXPORT int  filter(double *x, double *P, const double *H, const double *v,
                    const double *R, int n, int m);
+EXPORT int  filterdiag(double *x, double *P, const double *H, const double *v,
+                       const double *var, int n, int m);
+EXPORT int  filterws(wsbuf_t *ws, double *x, double *P, const double *H,
+                     const double *v, const double *R, int diag, int n, int m);
 EXPORT int  smoother(const double *xf, const double *Qf, const double *xb,
                      const double *Qb, int n, double *xs, double *Qs);
 EXPORT void matprint (const double *A, int n, int m, int p, int q);
@@ -1422,6 +1484,10 @@ EXPORT double dms2deg(const double *dms);
 EXPORT void readpos(const char *file, const char *rcv, double *pos);
 EXPORT int  sortobs(obs_t *obs);
 EXPORT void uniqnav(nav_t *nav);
+EXPORT int  indexeph(nav_t *nav);
+EXPORT int  setsatmeta(nav_t *nav);
+EXPORT const int *searcheph(const nav_t *nav, int sat, gtime_t time, double tmax,
+                            int *n);
 EXPORT int  screent(gtime_t time, gtime_t ts, gtime_t te, double tint);
 EXPORT int  readnav(const char *file, nav_t *nav);
 EXPORT int  savenav(const char *file, const nav_t *nav);
@@ -1531,6 +1597,10 @@ EXPORT double geph2clk(gtime_t time, const geph_t *geph);
 EXPORT double seph2clk(gtime_t time, const seph_t *seph);
 EXPORT void eph2pos (gtime_t time, const eph_t  *eph,  double *rs, double *dts,
                      double *var);
+EXPORT void eph2posvel(gtime_t time, const eph_t *eph, double *rs, double *dts,
+                       double *var);
+EXPORT void eph2posvels(const gtime_t *time, const eph_t **eph, int n,
+                        double *rs, double *dts, double *var);
 EXPORT void geph2pos(gtime_t time, const geph_t *geph, double *rs, double *dts,
                      double *var);
 EXPORT void seph2pos(gtime_t time, const seph_t *seph, double *rs, double *dts,
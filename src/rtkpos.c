@@ -435,6 +435,7 @@ static int selsat(const obsd_t *obs, double *azel, int nu, int nr,
 /* temporal update of position/velocity/acceleration -------------------------*/
 static void udpos(rtk_t *rtk, double tt)
 {
+    wsbuf_t *ws=&rtk->ws;
     double *F,*P,*FP,*x,*xp,pos[3],Q[9]={0},Qv[9],var=0.0;
     int i,j,*ix,nx;
     
@@ -474,16 +475,18 @@ static void udpos(rtk_t *rtk, double tt)
         return;
     }
     /* generate valid state index */
-    ix=imat(rtk->nx,1);
+    ix=wsimat(ws,rtk->nx,1);
     for (i=nx=0;i<rtk->nx;i++) {
         if (rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0) ix[nx++]=i;
     }
     if (nx<9) {
-        free(ix);
+        wsrelease(ws,ix);
         return;
     }
     /* state transition of position/velocity/acceleration */
-    F=eye(nx); P=mat(nx,nx); FP=mat(nx,nx); x=mat(nx,1); xp=mat(nx,1);
+    F=wszeros(ws,nx,nx); P=wsmat(ws,nx,nx); FP=wsmat(ws,nx,nx); x=wsmat(ws,nx,1);
+    xp=wsmat(ws,nx,1);
+    for (i=0;i<nx;i++) F[i+i*nx]=1.0;
     
     for (i=0;i<6;i++) {
         F[i+(i+3)*nx]=tt;
@@ -516,7 +519,8 @@ static void udpos(rtk_t *rtk, double tt)
     for (i=0;i<3;i++) for (j=0;j<3;j++) {
         rtk->P[i+6+(j+6)*rtk->nx]+=Qv[i+j*3];
     }
-    free(ix); free(F); free(P); free(FP); free(x); free(xp);
+    wsrelease(ws,xp); wsrelease(ws,x); wsrelease(ws,FP); wsrelease(ws,P);
+    wsrelease(ws,F); wsrelease(ws,ix);
 }
 /* temporal update of ionospheric parameters ---------------------------------*/
 static void udion(rtk_t *rtk, double tt, double bl, const int *sat, int ns)
@@ -704,6 +708,7 @@ static void detslp_dop(rtk_t *rtk, const obsd_t *obs, int i, int rcv,
 static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
                    const int *iu, const int *ir, int ns, const nav_t *nav)
 {
+    wsbuf_t *ws=&rtk->ws;
     double cp,pr,cp1,cp2,pr1,pr2,*bias,offset,freqi,freq1,freq2,C1,C2;
     int i,j,k,slip,reset,nf=NF(&rtk->opt);
     
@@ -758,7 +763,7 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
             rtk->x[j]=0.0;
             rtk->ssat[sat[i]-1].lock[k]=-rtk->opt.minlock;
         }
-        bias=zeros(ns,1);
+        bias=wszeros(ws,ns,1);
         
         /* estimate approximate phase-bias by phase - code */
         for (i=j=0,offset=0.0;i<ns;i++) {
@@ -800,7 +805,7 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
             if (bias[i]==0.0||rtk->x[IB(sat[i],k,&rtk->opt)]!=0.0) continue;
             initx(rtk,bias[i],SQR(rtk->opt.std[0]),IB(sat[i],k,&rtk->opt));
         }
-        free(bias);
+        wsrelease(ws,bias);
     }
 }
 /* temporal update of states --------------------------------------------------*/
@@ -1044,6 +1049,7 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
                  double *azel, double *freq, const int *iu, const int *ir,
                  int ns, double *v, double *H, double *R, int *vflg)
 {
+    wsbuf_t *ws=&rtk->ws;
     prcopt_t *opt=&rtk->opt;
     double bl,dr[3],posu[3],posr[3],didxi=0.0,didxj=0.0,*im;
     double *tropr,*tropu,*dtdxr,*dtdxu,*Ri,*Rj,freqi,freqj,*Hi=NULL;
@@ -1054,8 +1060,9 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
     bl=baseline(x,rtk->rb,dr);
     ecef2pos(x,posu); ecef2pos(rtk->rb,posr);
     
-    Ri=mat(ns*nf*2+2,1); Rj=mat(ns*nf*2+2,1); im=mat(ns,1);
-    tropu=mat(ns,1); tropr=mat(ns,1); dtdxu=mat(ns,3); dtdxr=mat(ns,3);
+    Ri=wsmat(ws,ns*nf*2+2,1); Rj=wsmat(ws,ns*nf*2+2,1); im=wsmat(ws,ns,1);
+    tropu=wsmat(ws,ns,1); tropr=wsmat(ws,ns,1); dtdxu=wsmat(ws,ns,3);
+    dtdxr=wsmat(ws,ns,3);
     
     for (i=0;i<MAXSAT;i++) for (j=0;j<NFREQ;j++) {
         rtk->ssat[i].resp[j]=rtk->ssat[i].resc[j]=0.0;
@@ -1188,8 +1195,9 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
     /* DD measurement error covariance */
     ddcov(nb,b,Ri,Rj,nv,R);
     
-    free(Ri); free(Rj); free(im);
-    free(tropu); free(tropr); free(dtdxu); free(dtdxr);
+    wsrelease(ws,dtdxr); wsrelease(ws,dtdxu); wsrelease(ws,tropr);
+    wsrelease(ws,tropu); wsrelease(ws,im); wsrelease(ws,Rj);
+    wsrelease(ws,Ri);
     
     return nv;
 }
@@ -1305,12 +1313,13 @@ static void restamb(rtk_t *rtk, const double *bias, int nb, double *xa)
 /* hold integer ambiguity ----------------------------------------------------*/
 static void holdamb(rtk_t *rtk, const double *xa)
 {
+    wsbuf_t *ws=&rtk->ws;
     double *v,*H,*R;
     int i,n,m,f,info,index[MAXSAT],nb=rtk->nx-rtk->na,nv=0,nf=NF(&rtk->opt);
     
     trace(3,"holdamb :\n");
     
-    v=mat(nb,1); H=zeros(nb,rtk->nx);
+    v=wsmat(ws,nb,1); H=wszeros(ws,nb,rtk->nx);
     
     for (m=0;m<5;m++) for (f=0;f<nf;f++) {
         
@@ -1332,20 +1341,21 @@ static void holdamb(rtk_t *rtk, const double *xa)
         }
     }
     if (nv>0) {
-        R=zeros(nv,nv);
-        for (i=0;i<nv;i++) R[i+i*nv]=VAR_HOLDAMB;
+        R=wsmat(ws,nv,1);
+        for (i=0;i<nv;i++) R[i]=VAR_HOLDAMB;
         
         /* update states with constraints */
-        if ((info=filter(rtk->x,rtk->P,H,v,R,rtk->nx,nv))) {
+        if ((info=filterws(ws,rtk->x,rtk->P,H,v,R,1,rtk->nx,nv))) {
             errmsg(rtk,"filter error (info=%d)\n",info);
         }
-        free(R);
+        wsrelease(ws,R);
     }
-    free(v); free(H);
+    wsrelease(ws,H); wsrelease(ws,v);
 }
 /* resolve integer ambiguity by LAMBDA ---------------------------------------*/
 static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
 {
+    wsbuf_t *ws=&rtk->ws;
     prcopt_t *opt=&rtk->opt;
     int i,j,nb,info,nx=rtk->nx,na=rtk->na;
     double *DP,*y,*b,*db,*Qb,*Qab,*QQ,s[2];
@@ -1360,14 +1370,14 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
         return 0;
     }
     /* index of SD to DD transformation matrix D */
-    ix=imat(nx,2);
+    ix=wsimat(ws,nx,2);
     if ((nb=ddidx(rtk,ix))<=0) {
         errmsg(rtk,"no valid double-difference\n");
-        free(ix);
+        wsrelease(ws,ix);
         return 0;
     }
-    y=mat(nb,1); DP=mat(nb,nx-na); b=mat(nb,2); db=mat(nb,1); Qb=mat(nb,nb);
-    Qab=mat(na,nb); QQ=mat(na,nb);
+    y=wsmat(ws,nb,1); DP=wsmat(ws,nb,nx-na); b=wsmat(ws,nb,2); db=wsmat(ws,nb,1);
+    Qb=wsmat(ws,nb,nb); Qab=wsmat(ws,na,nb); QQ=wsmat(ws,na,nb);
     
     /* y=D*xc, Qb=D*Qc*D', Qab=Qac*D' */
     for (i=0;i<nb;i++) {
@@ -1428,8 +1438,9 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
         errmsg(rtk,"lambda error (info=%d)\n",info);
         nb=0;
     }
-    free(ix);
-    free(y); free(DP); free(b); free(db); free(Qb); free(Qab); free(QQ);
+    wsrelease(ws,QQ); wsrelease(ws,Qab); wsrelease(ws,Qb);
+    wsrelease(ws,db); wsrelease(ws,b); wsrelease(ws,DP); wsrelease(ws,y);
+    wsrelease(ws,ix);
     
     return nb; /* number of ambiguities */
 }
@@ -1460,6 +1471,7 @@ static int valpos(rtk_t *rtk, const double *v, const double *R, const int *vflg,
 static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
                   const nav_t *nav)
 {
+    wsbuf_t *ws=&rtk->ws;
     prcopt_t *opt=&rtk->opt;
     gtime_t time=obs[0].time;
     double *rs,*dts,*var,*y,*e,*azel,*freq,*v,*H,*R,*xp,*Pp,*xa,*bias,dt;
@@ -1472,8 +1484,11 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
     
     dt=timediff(time,obs[nu].time);
     
-    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); y=mat(nf*2,n); e=mat(3,n);
-    azel=zeros(2,n); freq=zeros(nf,n);
+    /* grow workspace arena to peak usage of previous epochs */
+    wsreserve(ws);
+    
+    rs=wsmat(ws,6,n); dts=wsmat(ws,2,n); var=wsmat(ws,1,n); y=wsmat(ws,nf*2,n);
+    e=wsmat(ws,3,n); azel=wszeros(ws,2,n); freq=wszeros(ws,nf,n);
     
     for (i=0;i<MAXSAT;i++) {
         rtk->ssat[i].sys=satsys(i+1,NULL);
@@ -1488,8 +1503,8 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
                y+nu*nf*2,e+nu*3,azel+nu*2,freq+nu*nf)) {
         errmsg(rtk,"initial base station position error\n");
         
-        free(rs); free(dts); free(var); free(y); free(e); free(azel);
-        free(freq);
+        wsrelease(ws,freq); wsrelease(ws,azel); wsrelease(ws,e);
+        wsrelease(ws,y); wsrelease(ws,var); wsrelease(ws,dts); wsrelease(ws,rs);
         return 0;
     }
     /* time-interpolation of residuals (for post-processing) */
@@ -1500,8 +1515,8 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
     if ((ns=selsat(obs,azel,nu,nr,opt,sat,iu,ir))<=0) {
         errmsg(rtk,"no common satellite\n");
         
-        free(rs); free(dts); free(var); free(y); free(e); free(azel);
-        free(freq);
+        wsrelease(ws,freq); wsrelease(ws,azel); wsrelease(ws,e);
+        wsrelease(ws,y); wsrelease(ws,var); wsrelease(ws,dts); wsrelease(ws,rs);
         return 0;
     }
     /* temporal update of states */
@@ -1509,11 +1524,13 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
     
     trace(4,"x(0)="); tracemat(4,rtk->x,1,NR(opt),13,4);
     
-    xp=mat(rtk->nx,1); Pp=zeros(rtk->nx,rtk->nx); xa=mat(rtk->nx,1);
+    xp=wsmat(ws,rtk->nx,1); Pp=wszeros(ws,rtk->nx,rtk->nx);
+    xa=wsmat(ws,rtk->nx,1);
     matcpy(xp,rtk->x,rtk->nx,1);
     
     ny=ns*nf*2+2;
-    v=mat(ny,1); H=zeros(rtk->nx,ny); R=mat(ny,ny); bias=mat(rtk->nx,1);
+    v=wsmat(ws,ny,1); H=wszeros(ws,rtk->nx,ny); R=wsmat(ws,ny,ny);
+    bias=wsmat(ws,rtk->nx,1);
     
     /* add 2 iterations for baseline-constraint moving-base */
     niter=opt->niter+(opt->mode==PMODE_MOVEB&&opt->baseline[0]>0.0?2:0);
@@ -1534,7 +1551,7 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
         }
         /* Kalman filter measurement update */
         matcpy(Pp,rtk->P,rtk->nx,rtk->nx);
-        if ((info=filter(xp,Pp,H,v,R,rtk->nx,nv))) {
+        if ((info=filterws(ws,xp,Pp,H,v,R,0,rtk->nx,nv))) {
             errmsg(rtk,"filter error (info=%d)\n",info);
             stat=SOLQ_NONE;
             break;
@@ -1642,8 +1659,10 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
         if (rtk->ssat[i].fix[j]==2&&stat!=SOLQ_FIX) rtk->ssat[i].fix[j]=1;
         if (rtk->ssat[i].slip[j]&1) rtk->ssat[i].slipc[j]++;
     }
-    free(rs); free(dts); free(var); free(y); free(e); free(azel); free(freq);
-    free(xp); free(Pp);  free(xa);  free(v); free(H); free(R); free(bias);
+    wsrelease(ws,bias); wsrelease(ws,R); wsrelease(ws,H); wsrelease(ws,v);
+    wsrelease(ws,xa); wsrelease(ws,Pp); wsrelease(ws,xp); wsrelease(ws,freq);
+    wsrelease(ws,azel); wsrelease(ws,e); wsrelease(ws,y); wsrelease(ws,var);
+    wsrelease(ws,dts); wsrelease(ws,rs);
     
     if (stat!=SOLQ_NONE) rtk->sol.stat=stat;
     
@@ -1658,6 +1677,7 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
 extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
 {
     sol_t sol0={{0}};
+    gtime_t time0={0};
     ambc_t ambc0={{{0}}};
     ssat_t ssat0={0};
     int i;
@@ -1673,6 +1693,16 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
     rtk->P=zeros(rtk->nx,rtk->nx);
     rtk->xa=zeros(rtk->na,1);
     rtk->Pa=zeros(rtk->na,rtk->na);
+    rtk->ix=imat(rtk->nx,1);
+    rtk->nix=0;
+    rtk->tmdl=time0;
+    for (i=0;i<3;i++) rtk->rmdl[i]=0.0;
+    rtk->mdl=NULL;
+    if (opt->mode>=PMODE_PPP_KINEMA&&
+        (rtk->mdl=(pppmdl_t *)malloc(sizeof(pppmdl_t)*MAXSAT))) {
+        for (i=0;i<MAXSAT;i++) rtk->mdl[i].stat=0;
+    }
+    wsinit(&rtk->ws,0); /* sized by wsreserve() to the peak usage */
     rtk->nfix=rtk->neb=0;
     for (i=0;i<MAXSAT;i++) {
         rtk->ambc[i]=ambc0;
@@ -1695,6 +1725,10 @@ extern void rtkfree(rtk_t *rtk)
     free(rtk->P ); rtk->P =NULL;
     free(rtk->xa); rtk->xa=NULL;
     free(rtk->Pa); rtk->Pa=NULL;
+    free(rtk->ix); rtk->ix=NULL;
+    free(rtk->mdl); rtk->mdl=NULL;
+    rtk->nix=0;
+    wsfree(&rtk->ws);
 }
 /* precise positioning ---------------------------------------------------------
 * input observation data and navigation message, compute rover position by 
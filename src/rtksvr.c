@@ -44,6 +44,7 @@
 *                            use integer types in stdint.h
 *-----------------------------------------------------------------------------*/
 #include "rtklib.h"
+#include "B2bLIB.h"
 
 #define MIN_INT_RESET   30000   /* mininum interval of reset command (ms) */
 
@@ -190,6 +191,7 @@ static void update_eph(rtksvr_t *svr, nav_t *nav, int ephsat, int ephset,
                 *geph3=*geph2;
                 *geph2=*geph1;
                 update_glofcn(svr);
+                setsatmeta(&svr->nav); /* glonass fcn by new ephemeris */
             }
         }
         svr->nmsg[index][6]++;
@@ -453,6 +455,108 @@ static void decodefile(rtksvr_t *svr, int index)
         rtksvrunlock(svr);
     }
 }
+/* exchange B2b buffer index atomically --------------------------------------*/
+static int xchg_b2b(volatile int *p, int v)
+{
+#ifdef WIN32
+    return (int)InterlockedExchange((volatile LONG *)p,(LONG)v);
+#else
+    return __atomic_exchange_n(p,v,__ATOMIC_ACQ_REL);
+#endif
+}
+/* publish decoded B2b corrections ---------------------------------------------
+* the decoder, the positioning and the published slot own one of the three
+* correction buffers each. the decoder swaps its buffer with the published one
+* and goes on decoding in a copy of it, the positioning swaps its buffer with
+* the published one if not taken yet. so an update or an IODP change is only a
+* pointer swap for the positioning, and neither side waits for the other.
+*-----------------------------------------------------------------------------*/
+static void publish_b2b(rtksvr_t *svr)
+{
+    int w=svr->b2bw;
+    
+    svr->b2bw=xchg_b2b(&svr->b2bpub,w|4)&3;
+    memcpy(svr->b2bbuf+svr->b2bw,svr->b2bbuf+w,sizeof(b2bsat_t));
+}
+/* take latest B2b corrections for positioning -------------------------------*/
+static void take_b2b(rtksvr_t *svr)
+{
+    if (svr->b2bpub&4) svr->b2br=xchg_b2b(&svr->b2bpub,svr->b2br)&3;
+    svr->nav.b2bp=svr->b2bbuf+svr->b2br;
+}
+/* decode B2b correction stream ----------------------------------------------*/
+static int decodeb2b(rtksvr_t *svr, int index)
+{
+    b2bstr_t *str=svr->b2bstr+index;
+    b2bsat_t *b2bsat=svr->b2bbuf+svr->b2bw;
+    int i,ret,nupd=0;
+    
+    tracet(4,"decodeb2b: index=%d\n",index);
+    
+    for (i=0;i<svr->nb[index];i++) {
+        if ((ret=inputB2bstr(str,svr->buff[index][i]))<0) {
+            svr->nmsg[index][9]++;
+            continue;
+        }
+        if (ret==1) {
+            if (dupB2bmsg(&svr->b2bdup,&str->msg)) continue; /* copy by other GEO */
+            ret=decodeB2bsat(&str->msg,b2bsat);
+        }
+        else if (ret==2) ret=updateB2bsat(&str->rec,b2bsat);
+        else continue;
+        
+        if (ret>0) {svr->nmsg[index][7]++; nupd++;} else svr->nmsg[index][9]++;
+    }
+    svr->nb[index]=0;
+    return nupd;
+}
+/* read B2b correction streams -----------------------------------------------*/
+static int readb2b(rtksvr_t *svr)
+{
+    uint8_t *p,*q;
+    int i,n,nupd=0;
+    
+    for (i=0;i<3;i++) {
+        if (svr->format[i]!=STRFMT_B2B) continue;
+        p=svr->buff[i]+svr->nb[i]; q=svr->buff[i]+svr->buffsize;
+        
+        if ((n=strread(svr->stream+i,p,q-p))<=0) continue;
+        strwrite(svr->stream+i+5,p,n);
+        svr->nb[i]+=n;
+        
+        /* save peek buffer */
+        rtksvrlock(svr);
+        n=n<svr->buffsize-svr->npb[i]?n:svr->buffsize-svr->npb[i];
+        memcpy(svr->pbuf[i]+svr->npb[i],p,n);
+        svr->npb[i]+=n;
+        rtksvrunlock(svr);
+        
+        nupd+=decodeb2b(svr,i);
+    }
+    return nupd;
+}
+/* B2b correction decoder thread -----------------------------------------------
+* B2b streams are read and decoded in this thread not to block positioning.
+* the decoded corrections are published without rtksvrlock.
+*-----------------------------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI b2bsvrthread(void *arg)
+#else
+static void *b2bsvrthread(void *arg)
+#endif
+{
+    rtksvr_t *svr=(rtksvr_t *)arg;
+    uint32_t tick;
+    
+    tracet(3,"b2bsvrthread:\n");
+    
+    while (svr->state) {
+        tick=tickget();
+        if (readb2b(svr)>0) publish_b2b(svr);
+        sleepms(svr->cycle-(int)(tickget()-tick));
+    }
+    return 0;
+}
 /* carrier-phase bias (fcb) correction ---------------------------------------*/
 static void corr_phase_bias(obsd_t *obs, int n, const nav_t *nav)
 {
@@ -572,7 +676,7 @@ static void *rtksvrthread(void *arg)
     uint32_t tick,ticknmea,tick1hz,tickreset;
     uint8_t *p,*q;
     char msg[128];
-    int i,j,n,fobs[3]={0},cycle,cputime;
+    int i,j,n,fobs[3]={0},cycle,cputime,nb2b=0,fb2b=0;
     
     tracet(3,"rtksvrthread:\n");
     
@@ -581,9 +685,19 @@ static void *rtksvrthread(void *arg)
     ticknmea=tick1hz=svr->tick-1000;
     tickreset=svr->tick-MIN_INT_RESET;
     
+    /* start B2b correction decoder thread */
+    for (i=0;i<3;i++) if (svr->format[i]==STRFMT_B2B) nb2b++;
+    if (nb2b) {
+#ifdef WIN32
+        fb2b=(svr->b2bthread=CreateThread(NULL,0,b2bsvrthread,svr,0,NULL))!=NULL;
+#else
+        fb2b=!pthread_create(&svr->b2bthread,NULL,b2bsvrthread,svr);
+#endif
+    }
     for (cycle=0;svr->state;cycle++) {
         tick=tickget();
         for (i=0;i<3;i++) {
+            if (svr->format[i]==STRFMT_B2B) continue;
             p=svr->buff[i]+svr->nb[i]; q=svr->buff[i]+svr->buffsize;
             
             /* read receiver raw/rtcm data from input stream */
@@ -606,6 +720,9 @@ static void *rtksvrthread(void *arg)
                 /* decode download file */
                 decodefile(svr,i);
             }
+            else if (svr->format[i]==STRFMT_B2B) {
+                continue; /* decoded by B2b decoder thread */
+            }
             else {
                 /* decode receiver raw/rtcm data */
                 fobs[i]=decoderaw(svr,i);
@@ -635,6 +752,11 @@ static void *rtksvrthread(void *arg)
             if (!strstr(svr->rtk.opt.pppopt,"-DIS_FCB")) {
                 corr_phase_bias(obs.data,obs.n,&svr->nav);
             }
+            /* take latest B2b corrections */
+            if (nb2b) {
+                if (!fb2b&&readb2b(svr)>0) publish_b2b(svr);
+                take_b2b(svr);
+            }
             /* rtk positioning */
             rtksvrlock(svr);
             rtkpos(&svr->rtk,obs.data,obs.n,&svr->nav);
@@ -673,6 +795,14 @@ static void *rtksvrthread(void *arg)
         /* sleep until next cycle */
         sleepms(svr->cycle-cputime);
     }
+    if (fb2b) {
+#ifdef WIN32
+        WaitForSingleObject(svr->b2bthread,10000);
+        CloseHandle(svr->b2bthread);
+#else
+        pthread_join(svr->b2bthread,NULL);
+#endif
+    }
     for (i=0;i<MAXSTRRTK;i++) strclose(svr->stream+i);
     for (i=0;i<3;i++) {
         svr->nb[i]=svr->npb[i]=0;
@@ -739,6 +869,20 @@ extern int rtksvrinit(rtksvr_t *svr)
     svr->nav.n =MAXSAT *2;
     svr->nav.ng=NSATGLO*2;
     svr->nav.ns=NSATSBS*2;
+    if (!setsatmeta(&svr->nav)) {
+        tracet(1,"rtksvrinit: malloc error\n");
+        return 0;
+    }
+    initB2b(&svr->nav);
+    for (i=0;i<3;i++) svr->b2bstr[i].nbyte=0;
+    initB2bdup(&svr->b2bdup);
+    if (!(svr->b2bbuf=(b2bsat_t *)malloc(sizeof(b2bsat_t)*3))) {
+        tracet(1,"rtksvrinit: malloc error\n");
+        return 0;
+    }
+    for (i=0;i<3;i++) initB2bsat(svr->b2bbuf+i);
+    svr->b2bw=0; svr->b2bpub=1; svr->b2br=2;
+    svr->b2bthread=0;
     
     for (i=0;i<3;i++) for (j=0;j<MAXOBSBUF;j++) {
         if (!(svr->obs[i][j].data=(obsd_t *)malloc(sizeof(obsd_t)*MAXOBS))) {
@@ -771,6 +915,8 @@ extern void rtksvrfree(rtksvr_t *svr)
     free(svr->nav.eph );
     free(svr->nav.geph);
     free(svr->nav.seph);
+    free(svr->nav.meta); svr->nav.meta=NULL;
+    free(svr->b2bbuf); svr->b2bbuf=NULL;
     for (i=0;i<3;i++) for (j=0;j<MAXOBSBUF;j++) {
         free(svr->obs[i][j].data);
     }
@@ -863,6 +1009,11 @@ extern int rtksvrstart(rtksvr_t *svr, int cycle, int buffsize, int *strs,
         svr->nave=0;
         for (i=0;i<3;i++) svr->rb_ave[i]=0.0;
     }
+    initB2bdup(&svr->b2bdup);
+    for (i=0;i<3;i++) initB2bsat(svr->b2bbuf+i);
+    svr->b2bw=0; svr->b2bpub=1; svr->b2br=2;
+    svr->nav.b2bp=NULL;
+    
     for (i=0;i<3;i++) { /* input/log streams */
         svr->nb[i]=svr->npb[i]=0;
         if (!(svr->buff[i]=(uint8_t *)malloc(buffsize))||
@@ -878,6 +1029,7 @@ extern int rtksvrstart(rtksvr_t *svr, int cycle, int buffsize, int *strs,
         /* initialize receiver raw and rtcm control */
         init_raw(svr->raw+i,formats[i]);
         init_rtcm(svr->rtcm+i);
+        svr->b2bstr[i].nbyte=0;
         
         /* set receiver and rtcm option */
         strcpy(svr->raw [i].opt,rcvopts[i]);
@@ -0,0 +1,124 @@
+/*------------------------------------------------------------------------------
+* rtklib benchmark driver : B2b text record decoder
+*
+* usage: b2bbench [file [npass]]
+*
+* Decodes the Type4 (clock) records of a B2b text file in memory with the
+* sscanf() decoder of the former reader (before) and decodeB2brec() (after),
+* prints the throughput in MB/s and checks both give the same records.
+*-----------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "B2bLIB.h"
+
+#define NPASS   5                   /* default number of decoding passes */
+
+static char *file="../../testdata/ClkCorr20240824.dat";
+
+/* decode B2b Type4 text record by sscanf() (former reader) ------------------*/
+static int decodeType4_sscanf(const char *line, b2brec_t *rec)
+{
+    const char *p;
+    int week,sow,i,n;
+    
+    if (sscanf(line,"%*d %d %d %d %*d %d %d %d %d%n",&week,&sow,&rec->tod,
+               &rec->iodssr,&rec->iodp,&rec->slot,&rec->n,&n)!=7) {
+        return 0;
+    }
+    for (i=0,p=line+n;i<MAXCLOCKCOR;i++,p+=n) {
+        if (sscanf(p,"%d %lf%n",rec->iodcorr+i,rec->val+i,&n)!=2) return 0;
+    }
+    if (sscanf(p,"%*d %*d")==EOF) return 0;
+    rec->type=4;
+    rec->time=bdt2gpst(bdt2time(week,sow));
+    return 1;
+}
+/* decode B2b Type4 text record by decodeB2brec() ----------------------------*/
+static int decodeType4(const char *line, b2brec_t *rec)
+{
+    return decodeB2brec(line,4,rec);
+}
+/* decode all lines and return throughput (MB/s) -----------------------------*/
+static double bench(int (*decode)(const char *, b2brec_t *), char **lines,
+                    int n, long size, int npass, b2brec_t *recs, int *nrec)
+{
+    b2brec_t rec;
+    unsigned int tick;
+    int i,j;
+    
+    tick=tickget();
+    for (i=0;i<npass;i++) {
+        for (j=*nrec=0;j<n;j++) {
+            memset(&rec,0,sizeof(b2brec_t));
+            if (decode(lines[j],&rec)) recs[(*nrec)++]=rec;
+        }
+    }
+    tick=tickget()-tick;
+    return tick>0?(double)size*npass/1E3/tick:0.0;
+}
+/* compare decoded records ---------------------------------------------------*/
+static int cmprecs(const b2brec_t *r1, const b2brec_t *r2, int n)
+{
+    int i,j;
+    
+    for (i=0;i<n;i++,r1++,r2++) {
+        if (timediff(r1->time,r2->time)!=0.0||r1->tod!=r2->tod||
+            r1->iodssr!=r2->iodssr||r1->iodp!=r2->iodp||r1->slot!=r2->slot||
+            r1->n!=r2->n) return 0;
+        for (j=0;j<MAXCLOCKCOR;j++) {
+            if (r1->iodcorr[j]!=r2->iodcorr[j]||r1->val[j]!=r2->val[j]) return 0;
+        }
+    }
+    return 1;
+}
+int main(int argc, char **argv)
+{
+    FILE *fp;
+    b2brec_t *recs1,*recs2;
+    char *buff,*p,**lines=NULL;
+    double mbs1,mbs2;
+    long size;
+    int npass=NPASS,n=0,nmax=0,nrec1,nrec2,stat;
+    
+    if (argc>1) file=argv[1];
+    if (argc>2) npass=atoi(argv[2]);
+    
+    if (!(fp=fopen(file,"rb"))) {
+        fprintf(stderr,"file open error: %s (unzip testdata)\n",file);
+        return -1;
+    }
+    fseek(fp,0,SEEK_END); size=ftell(fp); rewind(fp);
+    if (!(buff=(char *)malloc(size+1))||(long)fread(buff,1,size,fp)!=size) {
+        fprintf(stderr,"file read error: %s\n",file);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    buff[size]='\0';
+    
+    /* split lines */
+    for (p=buff;*p;n++) {
+        if (n>=nmax) {
+            nmax=nmax<=0?65536:nmax*2;
+            if (!(lines=(char **)realloc(lines,sizeof(char *)*nmax))) return -1;
+        }
+        lines[n]=p;
+        if (!(p=strchr(p,'\n'))) break;
+        *p++='\0';
+    }
+    if (!(recs1=(b2brec_t *)malloc(sizeof(b2brec_t)*n))||
+        !(recs2=(b2brec_t *)malloc(sizeof(b2brec_t)*n))) return -1;
+    
+    mbs1=bench(decodeType4_sscanf,lines,n,size,npass,recs1,&nrec1);
+    mbs2=bench(decodeType4       ,lines,n,size,npass,recs2,&nrec2);
+    
+    stat=nrec1==nrec2&&cmprecs(recs1,recs2,nrec1);
+    
+    printf("file   : %s (%ld bytes, %d lines, %d passes)\n",file,size,n,npass);
+    printf("before : sscanf()       %8.1f MB/s (%d records)\n",mbs1,nrec1);
+    printf("after  : decodeB2brec() %8.1f MB/s (%d records)\n",mbs2,nrec2);
+    printf("records: %s\n",stat?"equal":"DIFFERENT");
+    
+    free(buff); free(lines); free(recs1); free(recs2);
+    return stat?0:1;
+}
@@ -0,0 +1,8 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : dummy application functions
+*-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+
+extern int showmsg(const char *format, ...) {return 0;}
+extern void settspan(gtime_t ts, gtime_t te) {}
+extern void settime(gtime_t time) {}
@@ -0,0 +1,108 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : B2b orbit cache functions
+*-----------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/B2bLIB.h"
+
+static char *files[]={
+    "../../testdata/PrnMask20240824.dat","../../testdata/OrbCorr20240824.dat",
+    "../../testdata/DcbCorr20240824.dat","../../testdata/ClkCorr20240824.dat"
+};
+static char *navfile="../../testdata/brd42370.24p";
+static nav_t nav;
+static b2bcache_t cache;
+
+/* cached vs direct b2b corrected orbit of a session -------------------------*/
+static int session(gtime_t ts, int nint, double *drmax, double *dvmax)
+{
+    const double ds[]={0.0,1E-3,15.0,B2BCACHE_TINT-1E-3};
+    b2b_reader_t reader;
+    gtime_t time;
+    double rs1[6],rs2[6],drs[6],dts1[2],dts2[2],var1,var2,dr,dv;
+    int i,j,k,sat,svh1,svh2,n=0;
+    
+    assert(openB2breader(&reader,files,ts)==4);
+    initB2b(&nav);
+    
+    for (i=0;i<nint;i++) {
+        for (j=0;j<4;j++) {
+            time=timeadd(ts,i*B2BCACHE_TINT+ds[j]);
+            inputB2breader(&reader,&nav,time);
+            
+            for (sat=1;sat<=MAXSAT;sat++) {
+                nav.b2bsat.cache=NULL;
+                if (!satpos_B2b(time,time,sat,&nav,rs1,dts1,&var1,&svh1)) {
+                    continue;
+                }
+                nav.b2bsat.cache=&cache;
+                assert(satpos_B2b(time,time,sat,&nav,rs2,dts2,&var2,&svh2));
+                assert(svh1==svh2&&var1==var2);
+                
+                for (k=0;k<6;k++) drs[k]=rs1[k]-rs2[k];
+                dr=norm(drs,3);
+                dv=norm(drs+3,3);
+                
+                /* interval ends (0) or middle (1) */
+                k=j==2;
+                if (dr>drmax[k]) drmax[k]=dr;
+                if (dv>dvmax[k]) dvmax[k]=dv;
+                assert(fabs(dts1[0]-dts2[0])*CLIGHT<1E-6);
+                n++;
+            }
+        }
+    }
+    closeB2breader(&reader);
+    return n;
+}
+/* cached vs direct b2b corrected orbit at ends and middle of intervals ------*/
+static void utest1(void)
+{
+    double ep[]={2024,8,24,12,0,0},drmax[2]={0},dvmax[2]={0};
+    int n;
+    
+    if (!readRinex4Nav(navfile,&nav)) {
+        printf("%s utest1 : skipped (unzip testdata)\n",__FILE__);
+        return;
+    }
+    uniqnav(&nav);
+    initB2bcache(&cache);
+    
+    n=session(epoch2time(ep),120,drmax,dvmax);
+    
+    printf("ends: dr=%.3g m dv=%.3g m/s  middle: dr=%.3g m dv=%.3g m/s\n",
+           drmax[0],dvmax[0],drmax[1],dvmax[1]);
+    assert(n>0);
+    assert(drmax[0]<1E-6&&dvmax[0]<1E-6);
+    assert(drmax[1]<1E-4&&dvmax[1]<1E-6);
+    
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* cache kept over sessions with restarted generations of corrections -------*/
+static void utest2(void)
+{
+    double ep1[]={2024,8,24,10,0,0},ep2[]={2024,8,24,11,0,0};
+    double drmax[2]={0},dvmax[2]={0};
+    int n;
+    
+    if (nav.n<=0) {
+        printf("%s utest2 : skipped (unzip testdata)\n",__FILE__);
+        return;
+    }
+    /* the second session overlaps the entries of the first one */
+    n =session(epoch2time(ep2),60,drmax,dvmax);
+    n+=session(epoch2time(ep1),120,drmax,dvmax);
+    
+    assert(n>0);
+    assert(drmax[0]<1E-6&&dvmax[0]<1E-6);
+    assert(drmax[1]<1E-4&&dvmax[1]<1E-6);
+    freenav(&nav,0xFF);
+    
+    printf("%s utest2 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    return 0;
+}
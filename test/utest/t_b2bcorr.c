@@ -0,0 +1,81 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : B2b correction set functions
+*-----------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/B2bLIB.h"
+
+static nav_t nav;
+
+/* set B2b Type1 mask record of BDS slots ------------------------------------*/
+static void setmask(b2brec_t *rec, gtime_t time, int iodp, const int *slot,
+                    int n)
+{
+    int i;
+    
+    memset(rec,0,sizeof(b2brec_t));
+    rec->type=1; rec->time=time; rec->iodp=iodp;
+    for (i=0;i<n;i++) rec->mask[slot[i]-1]=1;
+}
+/* set B2b Type2 orbit record ------------------------------------------------*/
+static void setorb(b2brec_t *rec, gtime_t time, int slot, int iodcorr)
+{
+    memset(rec,0,sizeof(b2brec_t));
+    rec->type=2; rec->time=time; rec->slot=slot; rec->iodn=5;
+    rec->iodcorr[0]=iodcorr; rec->val[0]=0.1;
+}
+/* set B2b Type4 clock record of subtype 0 -----------------------------------*/
+static void setclk(b2brec_t *rec, gtime_t time, int iodp, int n, int iodcorr,
+                   double c0)
+{
+    int i;
+    
+    memset(rec,0,sizeof(b2brec_t));
+    rec->type=4; rec->time=time; rec->iodp=iodp;
+    for (i=0;i<n;i++) {
+        rec->iodcorr[i]=iodcorr; rec->val[i]=c0;
+    }
+}
+/* satellite missing from the mask of one generation -------------------------*/
+static void utest1(void)
+{
+    const int slots1[]={20,21},slots2[]={21};
+    const b2bsatp_t *b2bsatp;
+    double ep[]={2024,8,24,0,0,0};
+    gtime_t t0=epoch2time(ep);
+    b2brec_t rec;
+    int sat=satno(SYS_CMP,20);
+    
+    initB2b(&nav);
+    
+    /* generation of IODP=1 with C20 and C21 */
+    setmask(&rec,t0,1,slots1,2);              updateB2brec(&rec,&nav);
+    setorb (&rec,t0,20,1);                    updateB2brec(&rec,&nav);
+    setclk (&rec,t0,1,2,1,0.5);               updateB2brec(&rec,&nav);
+    b2bsatp=selB2bcorr(timeadd(t0,1.0),sat,&nav);
+    assert(b2bsatp&&b2bsatp->b2btype4.C0==0.5);
+    
+    /* generation of IODP=2 without C20 */
+    setmask(&rec,timeadd(t0,2.0),2,slots2,1); updateB2brec(&rec,&nav);
+    assert(!selB2bcorr(timeadd(t0,2.0),sat,&nav));
+    
+    /* C20 back in IODP=3, the corrections of IODP=1 are used until updated */
+    setmask(&rec,timeadd(t0,4.0),3,slots1,2); updateB2brec(&rec,&nav);
+    b2bsatp=selB2bcorr(timeadd(t0,4.0),sat,&nav);
+    assert(b2bsatp&&b2bsatp->b2btype4.Iodp==1&&b2bsatp->b2btype4.C0==0.5);
+    
+    /* clock of IODP=3 with orbit of IODP=1 by the same IODCorr */
+    setclk (&rec,timeadd(t0,5.0),3,2,1,0.7);  updateB2brec(&rec,&nav);
+    b2bsatp=selB2bcorr(timeadd(t0,5.0),sat,&nav);
+    assert(b2bsatp&&b2bsatp->b2btype4.Iodp==3&&b2bsatp->b2btype4.C0==0.7);
+    
+    /* corrections of IODP=1 too old */
+    assert(!selB2bcorr(timeadd(t0,200.0),sat,&nav));
+    
+    printf("%s utest1 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    return 0;
+}
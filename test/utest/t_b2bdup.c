@@ -0,0 +1,130 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : B2b duplicate frame filter functions
+*-----------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/B2bLIB.h"
+
+static b2bdup_t dup;
+static nav_t nav;
+
+/* set B2b frame with CRC-24 ---------------------------------------------------
+* type, tod, iodssr and 15 bits of payload at bit 29
+*-----------------------------------------------------------------------------*/
+static void setframe(b2bmsg_t *msg, int week, int tow, int prn, int type,
+                     int tod, int iodssr, int val)
+{
+    unsigned char buff[58];
+    int i;
+    
+    memset(msg,0,sizeof(b2bmsg_t));
+    msg->week=week; msg->tow=tow; msg->prn=prn;
+    setbitu(msg->msg, 0, 6,type);
+    setbitu(msg->msg, 6,17,tod);
+    setbitu(msg->msg,27, 2,iodssr);
+    setbitu(msg->msg,29,15,val);
+    buff[0]=msg->msg[0]>>2;
+    for (i=1;i<58;i++) {
+        buff[i]=(unsigned char)((msg->msg[i-1]<<6)|(msg->msg[i]>>2));
+    }
+    setbitu(msg->msg,462,24,rtk_crc24q(buff,58));
+}
+/* interleaved copies of frames of colliding CRCs ----------------------------*/
+static void utest1(void)
+{
+    b2bmsg_t a,b,c;
+    unsigned int crc;
+    int i,val;
+    
+    initB2bdup(&dup);
+    
+    /* Type2 frames of an epoch with the same low 10 bits of CRCs */
+    setframe(&a,2328,1000,59,2,3600,1,1);
+    crc=getbitu(a.msg,462,24);
+    for (val=2;val<32768;val++) {
+        setframe(&b,2328,1000,59,2,3600,1,val);
+        if ((getbitu(b.msg,462,24)&0x3FF)==(crc&0x3FF)) break;
+    }
+    assert(val<32768);
+    
+    assert(!dupB2bmsg(&dup,&a));
+    assert(!dupB2bmsg(&dup,&b));
+    for (i=0;i<3;i++) {
+        a.prn=b.prn=60+i; a.tow=b.tow=1001+i;
+        assert(dupB2bmsg(&dup,&a));
+        assert(dupB2bmsg(&dup,&b));
+    }
+    /* same key and different frame */
+    setframe(&c,2328,1004,59,2,3600,1,val+1);
+    assert(!dupB2bmsg(&dup,&c));
+    
+    /* copy received too late */
+    a.tow=1000+(int)B2BDUP_TAGE+1;
+    assert(!dupB2bmsg(&dup,&a));
+    
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* frames broadcast by 3 GEO satellites for 2 hours --------------------------*/
+static void utest2(void)
+{
+    b2bmsg_t msg;
+    int i,j,k,type,n=0;
+    
+    initB2bdup(&dup);
+    
+    /* frame k received by PRN 59+j at k+j */
+    for (i=0;i<7200;i++) for (j=0;j<3;j++) {
+        if ((k=i-j)<0) continue;
+        type=k%5==0?1:(k%5<3?2:4);
+        setframe(&msg,2328,10000+i,59+j,type,k,1,k);
+        if (!dupB2bmsg(&dup,&msg)) n++;
+    }
+    assert(n==7200);
+    
+    printf("%s utest2 : OK\n",__FILE__);
+}
+/* corrections older than current ones rejected ------------------------------*/
+static void utest3(void)
+{
+    double ep[]={2024,8,24,0,0,0};
+    gtime_t t0=epoch2time(ep);
+    b2brec_t rec;
+    int sat=satno(SYS_CMP,20),gen;
+    
+    initB2b(&nav);
+    
+    memset(&rec,0,sizeof(rec));
+    rec.type=1; rec.time=t0; rec.iodp=1; rec.mask[19]=1;
+    updateB2brec(&rec,&nav);
+    gen=nav.b2bsat.gen;
+    
+    memset(&rec,0,sizeof(rec));
+    rec.type=2; rec.time=timeadd(t0,10.0); rec.slot=20; rec.iodn=5;
+    rec.val[0]=0.2;
+    updateB2brec(&rec,&nav);
+    rec.time=t0; rec.val[0]=0.1;
+    updateB2brec(&rec,&nav);
+    assert(nav.b2bsat.b2bsats[sat-1].b2btype2.OrbCorr[0]==0.2);
+    
+    memset(&rec,0,sizeof(rec));
+    rec.type=4; rec.time=timeadd(t0,10.0); rec.iodp=1; rec.val[0]=0.5;
+    updateB2brec(&rec,&nav);
+    rec.time=timeadd(t0,5.0); rec.val[0]=0.4;
+    updateB2brec(&rec,&nav);
+    assert(nav.b2bsat.b2bsats[sat-1].b2btype4.C0==0.5);
+    
+    /* replayed mask of another IODP */
+    memset(&rec,0,sizeof(rec));
+    rec.type=1; rec.time=timeadd(t0,-48.0); rec.iodp=0; rec.mask[19]=1;
+    updateB2brec(&rec,&nav);
+    assert(nav.b2bsat.gen==gen&&nav.b2bsat.b2btype1[0].Iodp==1);
+    
+    printf("%s utest3 : OK\n",__FILE__);
+}
+int main(void)
+{
+    utest1();
+    utest2();
+    utest3();
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : B2b message decoder functions
+*-----------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "../../src/B2bLIB.h"
+
+static char *files[]={
+    "../../testdata/PrnMask20240824.dat","../../testdata/OrbCorr20240824.dat",
+    "../../testdata/DcbCorr20240824.dat","../../testdata/ClkCorr20240824.dat"
+};
+static nav_t nav1,nav2;
+static b2brec_t *recs;
+static b2b_t b2b;
+static int nrec,nmax;
+
+/* set CRC-24 of B2b message -------------------------------------------------*/
+static void setcrc(unsigned char *msg)
+{
+    unsigned char buff[58];
+    int i;
+    
+    buff[0]=msg[0]>>2;
+    for (i=1;i<58;i++) {
+        buff[i]=(unsigned char)((msg[i-1]<<6)|(msg[i]>>2));
+    }
+    setbitu(msg,462,24,rtk_crc24q(buff,58));
+}
+/* encode B2b correction record to message (ICD PPP-B2b 6.2-6.4) -------------*/
+static void encframe(const b2brec_t *rec, unsigned char *p)
+{
+    int i,pos;
+    
+    memset(p,0,61);
+    setbitu(p, 0, 6,rec->type);
+    setbitu(p, 6,17,rec->tod);
+    setbitu(p,27, 2,rec->iodssr);
+    
+    switch (rec->type) {
+        case 1:
+            setbitu(p,29,4,rec->iodp);
+            for (i=0;i<MaskNSAT;i++) setbitu(p,33+i,1,rec->mask[i]);
+            break;
+        case 2: /* one satellite of six */
+            setbitu(p,29, 9,rec->slot);
+            setbitu(p,38,10,rec->iodn);
+            setbitu(p,48, 3,rec->iodcorr[0]);
+            setbits(p,51,15,(int)floor(rec->val[0]/0.0016+0.5));
+            setbits(p,66,13,(int)floor(rec->val[1]/0.0064+0.5));
+            setbits(p,79,13,(int)floor(rec->val[2]/0.0064+0.5));
+            setbitu(p,92, 3,rec->ura[0]);
+            setbitu(p,95, 3,rec->ura[1]);
+            break;
+        case 3: /* one satellite */
+            setbitu(p,29,5,1);
+            setbitu(p,34,9,rec->slot);
+            setbitu(p,43,4,rec->n);
+            for (i=0,pos=47;i<rec->n;i++,pos+=16) {
+                setbitu(p,pos  , 4,rec->mode[i]);
+                setbits(p,pos+4,12,(int)floor(rec->val[i]/0.017+0.5));
+            }
+            break;
+        case 4:
+            setbitu(p,29,4,rec->iodp);
+            setbitu(p,33,5,rec->slot);
+            for (i=0,pos=38;i<MAXCLOCKCOR;i++,pos+=18) {
+                setbitu(p,pos  , 3,rec->iodcorr[i]);
+                setbits(p,pos+3,15,(int)floor(rec->val[i]/0.0016+0.5));
+            }
+            break;
+    }
+    setcrc(p);
+}
+/* read B2b text file to records and messages ----------------------------------
+* the message reception time is the Week/Sow (BDT) of the line in GPST
+*-----------------------------------------------------------------------------*/
+static int readrecs(const char *file)
+{
+    static b2bstr_t str;
+    b2bmsg_t *msg;
+    FILE *fp;
+    gtime_t time;
+    char buff[2048],*p;
+    int val[3],week,sow,stat=0;
+    
+    if (!(fp=fopen(file,"r"))) return 0;
+    
+    while (fgets(buff,sizeof(buff),fp)) {
+        for (p=buff;*p;p++) stat=inputB2bstr(&str,(unsigned char)*p);
+        if (stat!=2||sscanf(buff,"%d %d %d",val,val+1,val+2)<3) continue;
+    
+        /* Type1: Week Sow ..., Type2-4: SatSlot/SubType Week Sow ... */
+        week=str.rec.type==1?val[0]:val[1];
+        sow =str.rec.type==1?val[1]:val[2];
+    
+        if (nrec>=nmax) {
+            nmax=nmax<=0?65536:nmax*2;
+            recs=(b2brec_t *)realloc(recs,sizeof(b2brec_t)*nmax);
+            b2b.msgs=(b2bmsg_t *)realloc(b2b.msgs,sizeof(b2bmsg_t)*nmax);
+            assert(recs&&b2b.msgs);
+        }
+        recs[nrec]=str.rec;
+        msg=b2b.msgs+nrec;
+        memset(msg,0,sizeof(b2bmsg_t));
+        time=gpst2time(week+1356,sow+14.0);
+        msg->tow=(int)floor(time2gpst(time,&msg->week)+0.5);
+        msg->prn=59;
+        msg->type=str.rec.type;
+        msg->iB2b=nrec++;
+        encframe(&str.rec,msg->msg);
+    }
+    fclose(fp);
+    return 1;
+}
+/* compare B2b messages by reception time and type ---------------------------*/
+static int cmpmsg(const void *p1, const void *p2)
+{
+    const b2bmsg_t *q1=(const b2bmsg_t *)p1,*q2=(const b2bmsg_t *)p2;
+    
+    if (q1->week!=q2->week) return q1->week-q2->week;
+    if (q1->tow !=q2->tow ) return q1->tow -q2->tow;
+    if (q1->type!=q2->type) return q1->type-q2->type;
+    return q1->iB2b-q2->iB2b;
+}
+/* compare B2b corrections of a satellite ------------------------------------*/
+static int cmpsat(const b2bsatp_t *p1, const b2bsatp_t *p2)
+{
+    int i;
+    
+    if (p1->gen!=p2->gen||p1->iodp!=p2->iodp||p1->iodssr!=p2->iodssr) return 0;
+    if (timediff(p1->b2btype2.t0,p2->b2btype2.t0)!=0.0||
+        p1->b2btype2.TodBDT!=p2->b2btype2.TodBDT||
+        p1->b2btype2.IODN!=p2->b2btype2.IODN||
+        p1->b2btype2.IodCorr!=p2->b2btype2.IodCorr||
+        p1->b2btype2.UraClass!=p2->b2btype2.UraClass||
+        p1->b2btype2.UraValue!=p2->b2btype2.UraValue) return 0;
+    for (i=0;i<3;i++) {
+        if (fabs(p1->b2btype2.OrbCorr[i]-p2->b2btype2.OrbCorr[i])>1E-9) return 0;
+    }
+    if (timediff(p1->b2btype3.t0,p2->b2btype3.t0)!=0.0) return 0;
+    for (i=0;i<NMODESINGAL;i++) {
+        if (fabs(p1->b2btype3.SatDCB[i]-p2->b2btype3.SatDCB[i])>1E-9) return 0;
+    }
+    return timediff(p1->b2btype4.t0,p2->b2btype4.t0)==0.0&&
+           p1->b2btype4.TodBDT==p2->b2btype4.TodBDT&&
+           p1->b2btype4.Iodp==p2->b2btype4.Iodp&&
+           p1->b2btype4.IodCorr==p2->b2btype4.IodCorr&&
+           fabs(p1->b2btype4.C0-p2->b2btype4.C0)<=1E-9;
+}
+/* text records vs messages re-encoded from them at every epoch --------------*/
+static void utest1(void)
+{
+    const b2bsat_t *b1=&nav1.b2bsat,*b2=&nav2.b2bsat;
+    b2brec_t *rec;
+    gtime_t time,te;
+    int i,j,k,sat,idx=0,n=0,nsel=0;
+    
+    for (i=0;i<4;i++) {
+        if (readrecs(files[i])) continue;
+        printf("%s utest1 : skipped (unzip testdata)\n",__FILE__);
+        return;
+    }
+    b2b.n=b2b.nmax=nrec;
+    qsort(b2b.msgs,b2b.n,sizeof(b2bmsg_t),cmpmsg);
+    initB2b(&nav1);
+    initB2b(&nav2);
+    
+    time=gpst2time(b2b.msgs[0].week,b2b.msgs[0].tow);
+    te=gpst2time(b2b.msgs[b2b.n-1].week,b2b.msgs[b2b.n-1].tow);
+    for (j=0;timediff(time,te)<=0.0;time=timeadd(time,1.0)) {
+    
+        /* text records in the order of the messages */
+        for (;j<b2b.n;j++) {
+            rec=recs+b2b.msgs[j].iB2b;
+            if (timediff(rec->time,time)>0.0) break;
+            updateB2brec(rec,&nav1);
+        }
+        inputB2bmsg(&b2b,&idx,&nav2,time);
+        assert(idx==j);
+    
+        assert(b1->gen==b2->gen&&b1->nsat==b2->nsat&&
+               timediff(b1->b2btype1[0].t0,b2->b2btype1[0].t0)==0.0&&
+               b1->b2btype1[0].Iodp==b2->b2btype1[0].Iodp);
+        for (k=0;k<MAXSAT;k++) {
+            assert(cmpsat(b1->b2bsats+k,b2->b2bsats+k));
+        }
+        for (sat=1;sat<=MAXSAT;sat++) {
+            if (selB2bcorr(time,sat,&nav1)) nsel++;
+        }
+        n++;
+    }
+    assert(nsel>0);
+    free(recs);
+    free(b2b.msgs);
+    
+    printf("%s utest1 : OK (epochs=%d corrections=%d)\n",__FILE__,n,nsel);
+}
+int main(void)
+{
+    utest1();
+    return 0;
+}
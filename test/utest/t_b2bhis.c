@@ -0,0 +1,76 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : B2b correction history functions
+*-----------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/B2bLIB.h"
+
+static char *files[]={
+    "../../testdata/PrnMask20240824.dat","../../testdata/OrbCorr20240824.dat",
+    "../../testdata/DcbCorr20240824.dat","../../testdata/ClkCorr20240824.dat"
+};
+static nav_t nav1,nav2;
+static b2bhis_t his;
+
+/* compare B2b corrections selected by reader and history --------------------*/
+static int cmpcorr(gtime_t time, int sat)
+{
+    const b2bsatp_t *p1=selB2bcorr(time,sat,&nav1);
+    const b2bsatp_t *p2=selB2bcorr(time,sat,&nav2);
+    
+    if (!p1||!p2) return !p1&&!p2;
+    return timediff(p1->b2btype2.t0,p2->b2btype2.t0)==0.0&&
+           p1->b2btype2.IODN==p2->b2btype2.IODN&&
+           p1->b2btype2.IodCorr==p2->b2btype2.IodCorr&&
+           p1->b2btype2.OrbCorr[0]==p2->b2btype2.OrbCorr[0]&&
+           p1->b2btype2.OrbCorr[1]==p2->b2btype2.OrbCorr[1]&&
+           p1->b2btype2.OrbCorr[2]==p2->b2btype2.OrbCorr[2]&&
+           timediff(p1->b2btype4.t0,p2->b2btype4.t0)==0.0&&
+           p1->b2btype4.Iodp==p2->b2btype4.Iodp&&
+           p1->b2btype4.C0==p2->b2btype4.C0;
+}
+/* inputB2bhis() vs inputB2breader() over the test session -------------------*/
+static void utest1(void)
+{
+    b2b_reader_t reader;
+    gtime_t ts={0},time;
+    int i,sat,n=0,nsel=0;
+    
+    if (openB2breader(&reader,files,ts)<4) {
+        printf("%s utest1 : skipped (unzip testdata)\n",__FILE__);
+        closeB2breader(&reader);
+        return;
+    }
+    assert(buildB2bhis(&his,&reader,NULL)>0);
+    closeB2breader(&reader);
+    
+    assert(openB2breader(&reader,files,ts)==4);
+    initB2b(&nav1);
+    initB2b(&nav2);
+    
+    time=timeadd(his.mask.time[0],1.0);
+    for (i=0;i<2880;i++,time=timeadd(time,30.0)) {
+        inputB2breader(&reader,&nav1,time);
+        inputB2bhis(&his,&nav2,time);
+        
+        /* the reader applies the records of an epoch by type, so the ones
+           before the first mask are dropped only by the history */
+        if (timediff(time,his.mask.time[0])<MAXAGEB2b) continue;
+        
+        for (sat=1;sat<=MAXSAT;sat++) {
+            assert(cmpcorr(time,sat));
+            if (selB2bcorr(time,sat,&nav1)) nsel++;
+        }
+        n++;
+    }
+    assert(nsel>0);
+    closeB2breader(&reader);
+    freeB2bhis(&his);
+    
+    printf("%s utest1 : OK (epochs=%d corrections=%d)\n",__FILE__,n,nsel);
+}
+int main(void)
+{
+    utest1();
+    return 0;
+}